@@ -0,0 +1,41 @@
+#include "DrawQueue.hpp"
+
+void DrawQueue::sort() {
+	batches.clear();
+	if (items.empty()) return;
+
+	//LSD radix sort of item indices by key, a byte per pass:
+	sorted.resize(items.size());
+	scratch.resize(items.size());
+	for (uint32_t i = 0; i < items.size(); ++i) {
+		sorted[i] = i;
+	}
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		uint32_t start[257] = { 0 };
+		for (uint32_t i : sorted) {
+			start[((key(items[i]) >> shift) & 0xff) + 1] += 1;
+		}
+		if (start[((key(items[sorted[0]]) >> shift) & 0xff) + 1] == sorted.size()) continue; //(every key has the same byte here)
+		for (uint32_t b = 0; b < 256; ++b) {
+			start[b + 1] += start[b];
+		}
+		for (uint32_t i : sorted) {
+			scratch[start[(key(items[i]) >> shift) & 0xff]++] = i;
+		}
+		sorted.swap(scratch);
+	}
+
+	//merge neighbours that can share a draw:
+	for (uint32_t i : sorted) {
+		Item const &item = items[i];
+		if (!batches.empty()) {
+			Item &last = batches.back();
+			if (last.pass == item.pass && last.texture == item.texture && last.program == item.program
+			 && last.buffer == item.buffer && last.offset + stride * last.count == item.offset) {
+				last.count += item.count;
+				continue;
+			}
+		}
+		batches.emplace_back(item);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * State-sorted draw submission.
+ *
+ * Each frame, runs of instances are submitted with the state they need
+ * (pass, order within the pass, texture, program) and where they live
+ * (buffer, byte offset, count). sort() radix-sorts them by that state --
+ * stably, so runs with equal keys keep their submission order -- and merges
+ * neighbours that share texture, program and buffer and sit back-to-back in
+ * it into one batch. The caller then issues one draw per batch, changing GL
+ * state only where consecutive batches differ.
+ */
+
+struct DrawQueue {
+	struct Item {
+		uint8_t pass; //sorts first; batches never span passes
+		uint8_t order; //draw order within the pass
+		uint8_t texture; //caller's texture slot
+		uint8_t program; //caller's program slot
+		GLuint buffer;
+		GLintptr offset; //in bytes
+		GLsizei count; //in instances
+	};
+
+	DrawQueue(GLsizeiptr stride) : stride(stride) { }
+
+	void clear() { items.clear(); }
+	void submit(Item const &item) { if (item.count > 0) items.emplace_back(item); }
+
+	//sort the submitted items into 'batches':
+	void sort();
+
+	GLsizeiptr stride; //bytes per instance
+	std::vector< Item > items; //in submission order
+	std::vector< Item > batches; //after sort()
+
+private:
+	static uint32_t key(Item const &item) {
+		return (uint32_t(item.pass) << 24) | (uint32_t(item.order) << 16) | (uint32_t(item.texture) << 8) | uint32_t(item.program);
+	}
+	std::vector< uint32_t > sorted, scratch; //item indices
+};
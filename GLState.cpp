@@ -0,0 +1,85 @@
+#include "GLState.hpp"
+
+#include <stdexcept>
+
+void GLState::use_program(GLuint program_) {
+	if (program == program_) { skipped += 1; return; }
+	glUseProgram(program_);
+	program = program_;
+	issued += 1;
+}
+
+void GLState::bind_vertex_array(GLuint vao_) {
+	if (vao == vao_) { skipped += 1; return; }
+	glBindVertexArray(vao_);
+	vao = vao_;
+	issued += 1;
+}
+
+void GLState::bind_array_buffer(GLuint buffer) {
+	if (array_buffer == buffer) { skipped += 1; return; }
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	array_buffer = buffer;
+	issued += 1;
+}
+
+void GLState::bind_texture(GLuint unit, GLuint texture) {
+	if (unit >= GLuint(TextureUnits)) throw std::runtime_error("GLState: texture unit out of range.");
+	if (active_unit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_unit = unit;
+		issued += 1;
+	}
+	if (textures[unit] == texture) { skipped += 1; return; }
+	glBindTexture(GL_TEXTURE_2D, texture);
+	textures[unit] = texture;
+	issued += 1;
+}
+
+void GLState::set_blend(bool enabled) {
+	if (blend == GLuint(enabled)) { skipped += 1; return; }
+	if (enabled) glEnable(GL_BLEND);
+	else glDisable(GL_BLEND);
+	blend = GLuint(enabled);
+	issued += 1;
+}
+
+void GLState::blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha) {
+	if (blend_funcs[0] == src_rgb && blend_funcs[1] == dst_rgb && blend_funcs[2] == src_alpha && blend_funcs[3] == dst_alpha) {
+		skipped += 1;
+		return;
+	}
+	glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+	blend_funcs[0] = src_rgb;
+	blend_funcs[1] = dst_rgb;
+	blend_funcs[2] = src_alpha;
+	blend_funcs[3] = dst_alpha;
+	issued += 1;
+}
+
+void GLState::set_depth_test(bool enabled) {
+	if (depth_test == GLuint(enabled)) { skipped += 1; return; }
+	if (enabled) glEnable(GL_DEPTH_TEST);
+	else glDisable(GL_DEPTH_TEST);
+	depth_test = GLuint(enabled);
+	issued += 1;
+}
+
+void GLState::depth_mask(bool write) {
+	if (depth_write == GLuint(write)) { skipped += 1; return; }
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	depth_write = GLuint(write);
+	issued += 1;
+}
+
+void GLState::invalidate() {
+	program = vao = array_buffer = Unknown;
+	active_unit = Unknown;
+	for (GLuint &texture : textures) {
+		texture = Unknown;
+	}
+	blend = depth_test = depth_write = Unknown;
+	for (GLenum &func : blend_funcs) {
+		func = Unknown;
+	}
+}
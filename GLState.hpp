@@ -0,0 +1,49 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <stdint.h>
+
+/*
+ * Shadow of the GL state the renderer changes every frame: bound program,
+ * vertex array, GL_ARRAY_BUFFER, GL_TEXTURE_2D per unit, blending, depth test
+ * and depth writes. Each setter skips the GL call when the state already
+ * matches, and counts calls issued versus skipped.
+ *
+ * The shadow starts out (and after invalidate() goes back to) unknown, so
+ * the first call for each piece of state is always issued. Call invalidate()
+ * after changing any of this state behind its back, or forget_array_buffer()
+ * after deleting a buffer that may be bound to GL_ARRAY_BUFFER (GL then
+ * quietly unbinds it).
+ */
+
+struct GLState {
+	static const int TextureUnits = 8;
+
+	GLState() { invalidate(); }
+
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vao);
+	void bind_array_buffer(GLuint buffer);
+	void bind_texture(GLuint unit, GLuint texture); //GL_TEXTURE_2D on texture unit 'unit' (which is left active)
+	void set_blend(bool enabled);
+	void blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+	void blend_func(GLenum src, GLenum dst) { blend_func(src, dst, src, dst); }
+	void set_depth_test(bool enabled);
+	void depth_mask(bool write);
+
+	void invalidate();
+	void forget_array_buffer() { array_buffer = Unknown; }
+
+	//counters (never reset here; callers may zero them):
+	uint64_t issued = 0; //GL calls made
+	uint64_t skipped = 0; //calls left out because the state already matched
+
+private:
+	static const GLuint Unknown = -1U;
+	GLuint program, vao, array_buffer;
+	GLuint active_unit;
+	GLuint textures[TextureUnits];
+	GLuint blend, depth_test, depth_write; //(1, 0 or Unknown)
+	GLenum blend_funcs[4];
+};
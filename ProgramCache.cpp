@@ -0,0 +1,86 @@
+#include "ProgramCache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+ProgramCache::ProgramCache(std::string const &directory_, void *(*get_proc_address)(char const *)) : directory(directory_) {
+	for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+		char const *str = reinterpret_cast< char const * >(glGetString(name));
+		driver += (str ? str : "");
+		driver += '\n';
+	}
+	get_program_binary = reinterpret_cast< PFNGLGETPROGRAMBINARYPROC >(get_proc_address("glGetProgramBinary"));
+	program_binary = reinterpret_cast< PFNGLPROGRAMBINARYPROC >(get_proc_address("glProgramBinary"));
+	program_parameteri = reinterpret_cast< PFNGLPROGRAMPARAMETERIPROC >(get_proc_address("glProgramParameteri"));
+	//(GL_NUM_PROGRAM_BINARY_FORMATS is an unknown enum, leaving 'formats' at 0, without the extension)
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	while (glGetError() != GL_NO_ERROR) { }
+	enabled = (get_program_binary && program_binary && program_parameteri && formats > 0);
+}
+
+std::string ProgramCache::key(std::string const &sources) const {
+	//64-bit FNV-1a of the sources and driver strings:
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (std::string const *str : {&sources, &driver}) {
+		for (char c : *str) {
+			hash = (hash ^ uint8_t(c)) * 0x100000001b3ULL;
+		}
+	}
+	char hex[17];
+	for (int i = 0; i < 16; ++i) {
+		hex[i] = "0123456789abcdef"[(hash >> (60 - 4 * i)) & 0xf];
+	}
+	hex[16] = '\0';
+	return hex;
+}
+
+//file layout: the binary format (a GLenum), then the binary:
+GLuint ProgramCache::load(std::string const &key) {
+	if (!enabled) return 0;
+	std::ifstream file((directory + "program-" + key + ".bin").c_str(), std::ios::binary);
+	std::vector< char > data((std::istreambuf_iterator< char >(file)), std::istreambuf_iterator< char >());
+	if (data.size() <= sizeof(GLenum)) {
+		misses += 1;
+		return 0;
+	}
+	GLenum format = 0;
+	std::memcpy(&format, &data[0], sizeof(format));
+
+	GLuint program = glCreateProgram();
+	program_binary(program, format, &data[sizeof(format)], GLsizei(data.size() - sizeof(format)));
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		//(a rejected binary also sets GL_INVALID_ENUM / GL_INVALID_VALUE on some drivers)
+		while (glGetError() != GL_NO_ERROR) { }
+		glDeleteProgram(program);
+		rejected += 1;
+		misses += 1;
+		return 0;
+	}
+	hits += 1;
+	return program;
+}
+
+void ProgramCache::prepare(GLuint program) {
+	if (!enabled) return;
+	program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(std::string const &key, GLuint program) {
+	if (!enabled) return;
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector< char > data(sizeof(GLenum) + length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	get_program_binary(program, length, &written, &format, &data[sizeof(format)]);
+	if (written <= 0) return;
+	std::memcpy(&data[0], &format, sizeof(format));
+	std::ofstream file((directory + "program-" + key + ".bin").c_str(), std::ios::binary);
+	file.write(&data[0], sizeof(format) + written);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+#include <stdint.h>
+
+/*
+ * On-disk cache of linked shader programs.
+ *
+ * Programs are stored as glGetProgramBinary output in 'directory', one file
+ * per key. A key is a hash of the shader sources plus the GL vendor, renderer
+ * and version strings, so a driver update or a different GPU misses instead
+ * of loading a stale binary. The driver may also reject a binary, e.g. after
+ * an update that keeps the version string. load() then returns 0 and the
+ * caller compiles from source, as it does on any miss.
+ *
+ * Some drivers only hand out a (reusable) binary for programs linked with
+ * GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, so prepare() each program before
+ * linking it.
+ *
+ * glGetProgramBinary / glProgramBinary / glProgramParameteri are GL 4.1 (or
+ * ARB_get_program_binary), so they are looked up at run time; without them
+ * the cache does nothing.
+ */
+
+struct ProgramCache {
+	//'get_proc_address' looks up GL entry points (e.g. SDL_GL_GetProcAddress); 'directory' ends with a separator:
+	ProgramCache(std::string const &directory, void *(*get_proc_address)(char const *));
+
+	//the key for a program built from 'sources' (all its shaders' sources, concatenated):
+	std::string key(std::string const &sources) const;
+
+	//a linked program from the binary stored under 'key', or 0 if there isn't one or the driver rejects it:
+	GLuint load(std::string const &key);
+	//asks for a retrievable binary of 'program' (call before glLinkProgram):
+	void prepare(GLuint program);
+	//stores the binary of linked program 'program' under 'key':
+	void store(std::string const &key, GLuint program);
+
+	bool enabled = false; //(the driver can save and load program binaries)
+
+	//counters:
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	uint32_t rejected = 0; //binaries found but not accepted by the driver (counted as misses too)
+
+private:
+	std::string directory;
+	std::string driver; //vendor / renderer / version, part of every key
+	PFNGLGETPROGRAMBINARYPROC get_program_binary = nullptr;
+	PFNGLPROGRAMBINARYPROC program_binary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC program_parameteri = nullptr;
+};
@@ -0,0 +1,176 @@
+#include "QuadBatch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define QUADS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define QUADS_AVX2_TARGET
+#else
+#define QUADS_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+//SSE2 is part of x86-64, and the default for 32-bit MSVC builds:
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUADS_SSE2 1
+#endif
+
+constexpr int16_t UnitTileCorners::x[4];
+constexpr int16_t UnitTileCorners::y[4];
+
+bool is_unit_tile(QuadTemplate const &quad) {
+	for (int c = 0; c < 4; ++c) {
+		if (quad.corners[c].Position.x != UnitTileCorners::x[c]) return false;
+		if (quad.corners[c].Position.y != UnitTileCorners::y[c]) return false;
+	}
+	return true;
+}
+
+//where corner 'c' of 'quad' sits, relative to the sprite's position:
+template< QuadShape Shape >
+struct CornerPosition {
+	static int16_t x(QuadTemplate const &quad, int c) { return quad.corners[c].Position.x; }
+	static int16_t y(QuadTemplate const &quad, int c) { return quad.corners[c].Position.y; }
+};
+template< >
+struct CornerPosition< QuadUnitTile > {
+	static int16_t x(QuadTemplate const &, int c) { return UnitTileCorners::x[c]; }
+	static int16_t y(QuadTemplate const &, int c) { return UnitTileCorners::y[c]; }
+};
+
+//a position in tiles to eighths, as the SIMD kernels convert it (cvtps_epi32 then packs_epi32):
+// rounded half-to-even and saturated to int16, with NaN and values past int32 (which the
+// conversion turns into INT32_MIN) giving -32768:
+static int16_t to_eighths(float tiles) {
+	float eighths = std::nearbyint(tiles * 8.0f);
+	if (!(eighths >= -2147483648.0f && eighths < 2147483648.0f)) return INT16_MIN;
+	return int16_t(std::min(std::max(eighths, -32768.0f), 32767.0f));
+}
+
+template< QuadShape Shape >
+static void emit_quads_scalar(QuadTemplate const *templates, glm::vec2 const *at, uint16_t const *sprites, size_t count, Vertex *out) {
+	for (size_t k = 0; k < count; ++k) {
+		int16_t x = to_eighths(at[k].x);
+		int16_t y = to_eighths(at[k].y);
+		QuadTemplate const &quad = templates[sprites[k]];
+		for (int c = 0; c < 4; ++c) {
+			out[4 * k + c].Position.x = int16_t(CornerPosition< Shape >::x(quad, c) + x);
+			out[4 * k + c].Position.y = int16_t(CornerPosition< Shape >::y(quad, c) + y);
+			out[4 * k + c].TexCoord = quad.corners[c].TexCoord;
+		}
+	}
+}
+
+#ifdef QUADS_SSE2
+template< QuadShape Shape >
+static void emit_quads_sse2(QuadTemplate const *templates, glm::vec2 const *at, uint16_t const *sprites, size_t count, Vertex *out) {
+	__m128 const eighths = _mm_set1_ps(8.0f);
+	//each vertex is (x, y, u, v) in 16-bit lanes; a sprite's (x, y) only goes into the position half:
+	__m128i const position_mask = _mm_setr_epi32(-1, 0, -1, 0);
+	//(QuadUnitTile) corners 0,1 and 2,3 with zero uvs:
+	__m128i const unit_corners[2] = {
+		_mm_setr_epi16(UnitTileCorners::x[0], UnitTileCorners::y[0], 0, 0, UnitTileCorners::x[1], UnitTileCorners::y[1], 0, 0),
+		_mm_setr_epi16(UnitTileCorners::x[2], UnitTileCorners::y[2], 0, 0, UnitTileCorners::x[3], UnitTileCorners::y[3], 0, 0),
+	};
+	size_t k = 0;
+	for (; k + 4 <= count; k += 4) {
+		__m128 a = _mm_loadu_ps(&at[k].x); //sprites k, k+1
+		__m128 b = _mm_loadu_ps(&at[k + 2].x); //sprites k+2, k+3
+		__m128i xy = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, eighths)), _mm_cvtps_epi32(_mm_mul_ps(b, eighths)));
+		int32_t xys[4]; //sprite i's 16-bit (x, y) as one 32-bit lane
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(xys), xy);
+		for (int i = 0; i < 4; ++i) {
+			__m128i const *quad = reinterpret_cast< __m128i const * >(&templates[sprites[k + i]]);
+			__m128i offset = _mm_and_si128(_mm_set1_epi32(xys[i]), position_mask);
+			__m128i *dst = reinterpret_cast< __m128i * >(out + 4 * (k + i));
+			for (int h = 0; h < 2; ++h) {
+				if (Shape == QuadUnitTile) {
+					//(only the uvs come from the template)
+					__m128i uvs = _mm_andnot_si128(position_mask, _mm_loadu_si128(quad + h));
+					_mm_storeu_si128(dst + h, _mm_or_si128(_mm_add_epi16(unit_corners[h], offset), uvs));
+				} else {
+					_mm_storeu_si128(dst + h, _mm_add_epi16(_mm_loadu_si128(quad + h), offset));
+				}
+			}
+		}
+	}
+	emit_quads_scalar< Shape >(templates, at + k, sprites + k, count - k, out + 4 * k);
+}
+#endif
+
+#ifdef QUADS_X86
+template< QuadShape Shape >
+QUADS_AVX2_TARGET
+static void emit_quads_avx2(QuadTemplate const *templates, glm::vec2 const *at, uint16_t const *sprites, size_t count, Vertex *out) {
+	__m256 const eighths = _mm256_set1_ps(8.0f);
+	__m256i const position_mask = _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0);
+	//(QuadUnitTile) all four corners with zero uvs:
+	__m256i const unit_corners = _mm256_setr_epi16(
+		UnitTileCorners::x[0], UnitTileCorners::y[0], 0, 0, UnitTileCorners::x[1], UnitTileCorners::y[1], 0, 0,
+		UnitTileCorners::x[2], UnitTileCorners::y[2], 0, 0, UnitTileCorners::x[3], UnitTileCorners::y[3], 0, 0);
+	//packs works per 128-bit half, leaving sprites in order 0 1 4 5 2 3 6 7:
+	__m256i const unshuffle = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	size_t k = 0;
+	for (; k + 8 <= count; k += 8) {
+		__m256 a = _mm256_loadu_ps(&at[k].x); //sprites k .. k+3
+		__m256 b = _mm256_loadu_ps(&at[k + 4].x); //sprites k+4 .. k+7
+		__m256i xy = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(a, eighths)), _mm256_cvtps_epi32(_mm256_mul_ps(b, eighths)));
+		xy = _mm256_permutevar8x32_epi32(xy, unshuffle);
+		int32_t xys[8];
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(xys), xy);
+		for (int i = 0; i < 8; ++i) {
+			__m256i quad = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(&templates[sprites[k + i]]));
+			__m256i offset = _mm256_and_si256(_mm256_set1_epi32(xys[i]), position_mask);
+			__m256i placed;
+			if (Shape == QuadUnitTile) {
+				//(only the uvs come from the template)
+				placed = _mm256_or_si256(_mm256_add_epi16(unit_corners, offset), _mm256_andnot_si256(position_mask, quad));
+			} else {
+				placed = _mm256_add_epi16(quad, offset);
+			}
+			_mm256_storeu_si256(reinterpret_cast< __m256i * >(out + 4 * (k + i)), placed);
+		}
+	}
+	emit_quads_scalar< Shape >(templates, at + k, sprites + k, count - k, out + 4 * k);
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	//...and the OS saves the ymm registers:
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+std::vector< QuadKernel > const &quad_kernels() {
+	static std::vector< QuadKernel > kernels;
+	if (kernels.empty()) {
+		kernels.push_back(QuadKernel{ "scalar", emit_quads_scalar< QuadGeneral >, emit_quads_scalar< QuadUnitTile > });
+#ifdef QUADS_SSE2
+		kernels.push_back(QuadKernel{ "sse2", emit_quads_sse2< QuadGeneral >, emit_quads_sse2< QuadUnitTile > });
+#endif
+#ifdef QUADS_X86
+		if (cpu_has_avx2()) kernels.push_back(QuadKernel{ "avx2", emit_quads_avx2< QuadGeneral >, emit_quads_avx2< QuadUnitTile > });
+#endif
+	}
+	return kernels;
+}
+
+QuadKernel const &best_quad_kernel() {
+	return quad_kernels().back();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Vertex.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Batch quad emitter.
+ *
+ * A QuadTemplate is a sprite's four quad corners (bottom-left, top-left,
+ * bottom-right, top-right) as drawn at the origin. Placing a sprite just adds
+ * its position, in eighths of a tile, to the template's positions -- so the
+ * SSE2 and AVX2 kernels emit 4 / 8 sprites per loop with 16-bit integer adds.
+ *
+ * Every kernel writes the same vertices for any input: positions are rounded
+ * half-to-even to eighths and saturated to int16 (NaN becomes -32768), then the
+ * corner offsets are added with 16-bit wraparound. (So only positions within
+ * about +-4095 tiles come out where they were asked for.) best_quad_kernel()
+ * picks the widest kernel the CPU runs.
+ *
+ * Most quads are plain 8x8 tiles (floor, walls, wires, text glyphs) whose corners
+ * are UnitTileCorners. A batch known to hold only those can go through a
+ * kernel's emit_unit_tiles, which takes the corner positions as compile-time
+ * constants and reads only the uvs from the templates. The shape is chosen
+ * once per batch, not per sprite.
+ */
+
+struct QuadTemplate {
+	Vertex corners[4];
+};
+static_assert(sizeof(QuadTemplate) == 32, "QuadTemplate is one AVX register.");
+
+//what every quad in a batch is known to look like:
+enum QuadShape {
+	QuadGeneral,
+	QuadUnitTile, //a 1x1 tile hanging below and right of the sprite's position (corners as UnitTileCorners)
+};
+
+//QuadUnitTile corner positions, in eighths of a tile (same corner order as QuadTemplate):
+struct UnitTileCorners {
+	static constexpr int16_t x[4] = { 0, 0, 8, 8 };
+	static constexpr int16_t y[4] = { -8, 0, -8, 0 };
+};
+
+//is 'quad' a QuadUnitTile?
+bool is_unit_tile(QuadTemplate const &quad);
+
+//writes 4 * count vertices to 'out'; sprite k is templates[sprites[k]] placed at at[k] (in tiles):
+typedef void (*EmitQuads)(QuadTemplate const *templates, glm::vec2 const *at, uint16_t const *sprites, size_t count, Vertex *out);
+
+struct QuadKernel {
+	char const *name;
+	EmitQuads emit; //(any quads)
+	EmitQuads emit_unit_tiles; //(only QuadUnitTile quads)
+
+	EmitQuads emit_shape(QuadShape shape) const {
+		return (shape == QuadUnitTile ? emit_unit_tiles : emit);
+	}
+};
+
+//the kernels this CPU can run, narrowest (scalar) first:
+std::vector< QuadKernel > const &quad_kernels();
+//the widest of those:
+QuadKernel const &best_quad_kernel();
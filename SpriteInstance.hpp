@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+//One sprite as drawn by the instanced sprite program: position, sprite table index, layer, tint.
+struct SpriteInstance {
+	SpriteInstance() = default;
+	SpriteInstance(glm::vec2 const &at_, uint32_t sprite_, glm::u8vec4 const &tint_, uint16_t layer_ = 0) :
+		at(glm::round(at_ * 8.0f)), sprite(uint16_t(sprite_)), layer(layer_), tint(tint_) { }
+	glm::i16vec2 at; //eighths of a tile, so the 4096x4096 maps still fit
+	uint16_t sprite; //index into the sprite table
+	uint16_t layer; //depth order; higher layers are in front (0 is the tile layer)
+	glm::u8vec4 tint;
+};
+static_assert(sizeof(SpriteInstance) == 12, "SpriteInstance is nicely packed.");
@@ -0,0 +1,150 @@
+#include "SpriteLayer.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+const SpriteLayer::Handle SpriteLayer::InvalidHandle;
+
+SpriteLayer::SpriteLayer(uint32_t buckets, std::function< uint32_t(SpriteInstance const &) > const &bucket_of_) : bucket_of(bucket_of_) {
+	if (buckets == 0) throw std::runtime_error("SpriteLayer: no buckets.");
+	bucket_end.assign(buckets, 0);
+	glGenBuffers(1, &buffer);
+}
+
+SpriteLayer::~SpriteLayer() {
+	glDeleteBuffers(1, &buffer);
+}
+
+SpriteLayer::Handle SpriteLayer::create_sprite(uint16_t sprite, glm::vec2 const &at, uint16_t layer) {
+	Handle handle;
+	if (!free_handles.empty()) {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	} else {
+		handle = Handle(handle_slot.size());
+		handle_slot.emplace_back(-1);
+		handle_bucket.emplace_back(0);
+	}
+	insert(handle, SpriteInstance(at, sprite, glm::u8vec4(0xff), layer));
+	return handle;
+}
+
+void SpriteLayer::move(Handle handle, glm::vec2 const &at) {
+	GLsizei slot = handle_slot[handle];
+	SpriteInstance instance = instances[slot];
+	instance.at = glm::i16vec2(glm::round(at * 8.0f));
+	if (instance.at == instances[slot].at) return;
+	place(slot, handle, instance);
+}
+
+void SpriteLayer::set_sprite(Handle handle, uint16_t sprite) {
+	GLsizei slot = handle_slot[handle];
+	if (instances[slot].sprite == sprite) return;
+	SpriteInstance instance = instances[slot];
+	instance.sprite = sprite;
+	if (bucket_of(instance) == handle_bucket[handle]) {
+		place(slot, handle, instance);
+	} else {
+		remove(handle);
+		insert(handle, instance);
+	}
+}
+
+void SpriteLayer::destroy(Handle handle) {
+	remove(handle);
+	handle_slot[handle] = -1;
+	free_handles.emplace_back(handle);
+}
+
+void SpriteLayer::place(GLsizei slot, Handle handle, SpriteInstance const &instance) {
+	instances[slot] = instance;
+	slot_handle[slot] = handle;
+	handle_slot[handle] = slot;
+	if (!dirty[slot]) {
+		dirty[slot] = true;
+		dirty_list.emplace_back(slot);
+	}
+}
+
+void SpriteLayer::insert(Handle handle, SpriteInstance const &instance) {
+	uint32_t bucket = bucket_of(instance);
+	if (bucket >= bucket_end.size()) throw std::runtime_error("SpriteLayer: bucket out of range.");
+	handle_bucket[handle] = bucket;
+
+	//open a hole at the end, then walk it down to 'bucket' by moving the
+	// first instance of each later bucket to that bucket's end:
+	instances.emplace_back();
+	slot_handle.emplace_back(InvalidHandle);
+	dirty.emplace_back(false);
+	GLsizei hole = GLsizei(instances.size()) - 1;
+	for (uint32_t b = uint32_t(bucket_end.size()) - 1; b > bucket; --b) {
+		GLsizei first = bucket_end[b - 1];
+		if (first != bucket_end[b]) {
+			place(hole, slot_handle[first], instances[first]);
+			hole = first;
+		}
+		bucket_end[b] += 1;
+	}
+	bucket_end[bucket] += 1;
+	place(hole, handle, instance);
+}
+
+void SpriteLayer::remove(Handle handle) {
+	uint32_t bucket = handle_bucket[handle];
+
+	//fill the hole with the last instance of its bucket, then walk the new
+	// hole up to the end by moving the last instance of each later bucket into it:
+	GLsizei hole = handle_slot[handle];
+	for (uint32_t b = bucket; b < bucket_end.size(); ++b) {
+		GLsizei last = bucket_end[b] - 1;
+		if (last > hole) {
+			place(hole, slot_handle[last], instances[last]);
+			hole = last;
+		}
+		bucket_end[b] -= 1;
+	}
+
+	instances.pop_back();
+	slot_handle.pop_back();
+	dirty.pop_back();
+	//(dirty_list may still name the dropped slot; update() skips it)
+}
+
+size_t SpriteLayer::update() {
+	size_t uploaded = 0;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (size() > capacity) {
+		//grow, re-sending everything:
+		capacity = std::max(size(), 2 * capacity);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * capacity, nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(SpriteInstance) * instances.size(), instances.data());
+		uploaded = sizeof(SpriteInstance) * instances.size();
+		uploaded_ranges += 1;
+		reallocations += 1;
+	} else if (!dirty_list.empty()) {
+		//send each run of adjacent dirty slots as one range:
+		std::sort(dirty_list.begin(), dirty_list.end());
+		dirty_list.erase(std::unique(dirty_list.begin(), dirty_list.end()), dirty_list.end());
+		size_t i = 0;
+		while (i < dirty_list.size() && dirty_list[i] < size()) {
+			GLsizei begin = dirty_list[i];
+			GLsizei end = begin + 1;
+			++i;
+			while (i < dirty_list.size() && dirty_list[i] == end && end < size()) {
+				++end;
+				++i;
+			}
+			GLsizeiptr bytes = sizeof(SpriteInstance) * (end - begin);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * begin, bytes, &instances[begin]);
+			uploaded += bytes;
+			uploaded_ranges += 1;
+		}
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	for (GLsizei slot : dirty_list) {
+		if (slot < size()) dirty[slot] = false;
+	}
+	dirty_list.clear();
+	return uploaded;
+}
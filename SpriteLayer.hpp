@@ -0,0 +1,69 @@
+#pragma once
+
+#include "GL.hpp"
+#include "SpriteInstance.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Retained sprite layer.
+ *
+ * Sprites live in 'buffer' between frames and are changed through handles;
+ * each change marks only the slots it touched dirty, and update() uploads the
+ * dirty slots as a few glBufferSubData ranges (adjacent slots are merged).
+ * A frame where nothing changed uploads nothing.
+ *
+ * Instances are kept packed and grouped into runs by bucket (bucket_of, given
+ * at construction, maps an instance to its bucket), in bucket order, so each
+ * bucket -- or any span of consecutive buckets -- draws as one contiguous run.
+ * Order within a bucket is unspecified. Creating or destroying a sprite moves
+ * at most one instance per bucket after its own.
+ */
+
+struct SpriteLayer {
+	typedef uint32_t Handle;
+	static const Handle InvalidHandle = -1U;
+
+	SpriteLayer(uint32_t buckets, std::function< uint32_t(SpriteInstance const &) > const &bucket_of);
+	~SpriteLayer();
+	SpriteLayer(SpriteLayer const &) = delete;
+	SpriteLayer &operator=(SpriteLayer const &) = delete;
+
+	Handle create_sprite(uint16_t sprite, glm::vec2 const &at, uint16_t layer);
+	void move(Handle handle, glm::vec2 const &at);
+	void set_sprite(Handle handle, uint16_t sprite);
+	void destroy(Handle handle);
+
+	//upload the dirty slots; returns the number of bytes uploaded:
+	size_t update();
+
+	//instances [bucket_begin(b), bucket_begin(b+1)) are bucket b's (bucket_begin(buckets) == size()):
+	GLsizei bucket_begin(uint32_t bucket) const { return bucket == 0 ? 0 : bucket_end[bucket - 1]; }
+	GLsizei size() const { return GLsizei(instances.size()); }
+
+	GLuint buffer = 0;
+
+	//counters (never reset here; callers may zero them):
+	uint64_t uploaded_ranges = 0; //glBufferSubData calls made by update()
+	uint64_t reallocations = 0;
+
+private:
+	void insert(Handle handle, SpriteInstance const &instance);
+	void remove(Handle handle);
+	void place(GLsizei slot, Handle handle, SpriteInstance const &instance);
+
+	std::function< uint32_t(SpriteInstance const &) > bucket_of;
+	std::vector< SpriteInstance > instances; //packed, in bucket order
+	std::vector< GLsizei > bucket_end; //one past each bucket's last slot
+	std::vector< Handle > slot_handle; //per slot
+	std::vector< GLsizei > handle_slot; //per handle (-1 if free)
+	std::vector< uint32_t > handle_bucket; //per handle
+	std::vector< Handle > free_handles;
+	std::vector< bool > dirty; //per slot
+	std::vector< GLsizei > dirty_list;
+	GLsizei capacity = 0; //instances 'buffer' has room for
+};
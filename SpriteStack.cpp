@@ -0,0 +1,47 @@
+#include "SpriteStack.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+SpriteStack::SpriteStack(GLsizei capacity_) : capacity(std::max(capacity_, 1)) {
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * capacity, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+SpriteStack::~SpriteStack() {
+	glDeleteBuffers(1, &buffer);
+}
+
+void SpriteStack::push(SpriteInstance const &instance) {
+	if (count == capacity) {
+		//grow, copying the old contents on the GPU:
+		GLuint old_buffer = buffer;
+		capacity *= 2;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * capacity, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(SpriteInstance) * count);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &old_buffer);
+		reallocations += 1;
+	}
+	count += 1;
+	set(count - 1, instance);
+}
+
+void SpriteStack::pop() {
+	if (count == 0) throw std::runtime_error("SpriteStack: pop from an empty stack.");
+	count -= 1;
+}
+
+void SpriteStack::set(GLsizei index, SpriteInstance const &instance) {
+	if (index < 0 || index >= count) throw std::runtime_error("SpriteStack: index out of range.");
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * index, sizeof(SpriteInstance), &instance);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	uploaded_bytes += sizeof(SpriteInstance);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "GL.hpp"
+#include "SpriteInstance.hpp"
+
+#include <stdint.h>
+
+/*
+ * GPU-side stack of SpriteInstances, for things that only grow and shrink at
+ * one end (like the wire).
+ *
+ * push() uploads just the new instance and set() just the one it rewrites;
+ * pop() only shrinks the draw count. So each operation costs O(1) however
+ * deep the stack is. Growing copies the old contents buffer-to-buffer on the
+ * GPU, so that is amortized O(1) too. Nothing is kept on the CPU.
+ */
+
+struct SpriteStack {
+	SpriteStack(GLsizei capacity = 256);
+	~SpriteStack();
+	SpriteStack(SpriteStack const &) = delete;
+	SpriteStack &operator=(SpriteStack const &) = delete;
+
+	void push(SpriteInstance const &instance);
+	void pop();
+	//rewrite instance 'index' (counted from the bottom):
+	void set(GLsizei index, SpriteInstance const &instance);
+
+	GLsizei size() const { return count; }
+
+	GLuint buffer = 0; //(changes when the stack grows)
+
+	//counters (never reset here; callers may zero them):
+	uint64_t uploaded_bytes = 0;
+	uint64_t reallocations = 0;
+
+private:
+	GLsizei count = 0;
+	GLsizei capacity;
+};
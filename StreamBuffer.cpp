@@ -0,0 +1,81 @@
+#include "StreamBuffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+//keep every write aligned for any attribute type:
+static const GLsizeiptr Alignment = 16;
+
+StreamBuffer::StreamBuffer(GLsizeiptr frame_size_, uint32_t frames_) : frames(frames_) {
+	if (frames == 0) throw std::runtime_error("StreamBuffer needs at least one frame.");
+	glGenBuffers(1, &buffer);
+	allocate(frame_size_);
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (auto &fence : fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void StreamBuffer::allocate(GLsizeiptr frame_size_) {
+	for (auto &fence : fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	fences.assign(frames, nullptr);
+	frame_size = (frame_size_ + Alignment - 1) / Alignment * Alignment;
+	current = 0;
+	used = 0;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, frame_size * frames, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLintptr StreamBuffer::write(void const *data, GLsizeiptr size) {
+	if (used + size > frame_size) {
+		//new storage is not in use by the GPU, so no fences to wait on:
+		allocate(std::max(2 * frame_size, used + size));
+		reallocations += 1;
+	}
+
+	if (GLsync fence = fences[current]) {
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			fence_waits += 1;
+			auto before = std::chrono::high_resolution_clock::now();
+			do {
+				result = glClientWaitSync(fence, 0, 1000000); //1ms
+			} while (result == GL_TIMEOUT_EXPIRED);
+			auto after = std::chrono::high_resolution_clock::now();
+			fence_wait_seconds += std::chrono::duration< double >(after - before).count();
+		}
+		if (result == GL_WAIT_FAILED) throw std::runtime_error("StreamBuffer: glClientWaitSync failed.");
+		glDeleteSync(fence);
+		fences[current] = nullptr;
+	}
+
+	GLintptr offset = current * frame_size + used;
+	if (size > 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		void *dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!dst) throw std::runtime_error("StreamBuffer: glMapBufferRange failed.");
+		std::memcpy(dst, data, size);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	used += (size + Alignment - 1) / Alignment * Alignment;
+	writes += 1;
+	return offset;
+}
+
+void StreamBuffer::next_frame() {
+	if (used > 0) {
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	current = (current + 1) % frames;
+	used = 0;
+}
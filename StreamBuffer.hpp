@@ -0,0 +1,50 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Ring buffer for data that is re-sent every frame.
+ *
+ * The GL buffer holds 'frames' regions. Each frame's writes go to the next
+ * region, mapped with GL_MAP_UNSYNCHRONIZED_BIT so the driver never stalls or
+ * orphans storage behind our back. next_frame() drops a fence after the frame's
+ * draws; the first write into a region waits on the fence left there by the
+ * frame that used it 'frames' frames ago.
+ *
+ * If a write does not fit in a region, the buffer is reallocated larger. That
+ * discards data written earlier in the same frame, so write each stream once
+ * per frame (or draw from a write before making the next one).
+ */
+
+struct StreamBuffer {
+	StreamBuffer(GLsizeiptr frame_size, uint32_t frames = 3);
+	~StreamBuffer();
+	StreamBuffer(StreamBuffer const &) = delete;
+	StreamBuffer &operator=(StreamBuffer const &) = delete;
+
+	//copy 'size' bytes into the current frame's region; returns their offset in 'buffer':
+	GLintptr write(void const *data, GLsizeiptr size);
+
+	//fence the current region and move on to the next one (call once the frame's draws are issued):
+	void next_frame();
+
+	GLuint buffer = 0;
+
+	//counters (never reset here; callers may zero them):
+	uint64_t writes = 0;
+	uint64_t fence_waits = 0; //times write() found the GPU still reading its region and had to block
+	double fence_wait_seconds = 0.0; //total time spent blocked in those waits
+	uint64_t reallocations = 0;
+
+private:
+	void allocate(GLsizeiptr frame_size);
+
+	GLsizeiptr frame_size = 0;
+	uint32_t frames = 0;
+	uint32_t current = 0; //region being written this frame
+	GLsizeiptr used = 0; //bytes written into it so far
+	std::vector< GLsync > fences; //per region; nullptr when the region is free
+};
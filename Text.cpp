@@ -0,0 +1,80 @@
+#include "Text.hpp"
+
+#include <cmath>
+
+const char GlyphTable::First;
+const char GlyphTable::Last;
+const uint16_t GlyphTable::NoGlyph;
+
+GlyphTable::GlyphTable() {
+	for (uint16_t &g : glyphs) {
+		g = NoGlyph;
+	}
+}
+
+void GlyphTable::set(char c, QuadTemplate const &quad) {
+	if (c < First || c > Last) return;
+	glyphs[c - First] = uint16_t(templates.size());
+	templates.emplace_back(quad);
+	if (!is_unit_tile(quad)) shape = QuadGeneral;
+}
+
+void TextMesh::set(GlyphTable const &table, char const *text_) {
+	if (text == text_) return;
+	text = text_;
+	layouts += 1;
+
+	glyph_at.clear();
+	glyph_index.clear();
+	for (size_t i = 0; i < text.size(); ++i) {
+		uint16_t g = table.glyph(text[i]);
+		if (g == GlyphTable::NoGlyph) continue;
+		glyph_at.emplace_back(float(i), 0.0f);
+		glyph_index.emplace_back(g);
+	}
+	verts.resize(4 * glyph_at.size());
+	best_quad_kernel().emit_shape(table.shape)(table.templates.data(), glyph_at.data(), glyph_index.data(), glyph_at.size(), verts.data());
+}
+
+void TextMesh::set_number(GlyphTable const &table, int32_t value) {
+	//longest int32_t is "-2147483648":
+	enum { MaxLength = 11 };
+	if (verts.capacity() < 4 * MaxLength) verts.reserve(4 * MaxLength);
+	if (text.capacity() < MaxLength) text.reserve(MaxLength);
+	if (glyph_at.capacity() < MaxLength) glyph_at.reserve(MaxLength);
+	if (glyph_index.capacity() < MaxLength) glyph_index.reserve(MaxLength);
+
+	char digits[MaxLength + 1];
+	char *start = digits + MaxLength;
+	*start = '\0';
+	uint32_t magnitude = (value < 0 ? 0U - uint32_t(value) : uint32_t(value));
+	do {
+		*(--start) = char('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+	if (value < 0) *(--start) = '-';
+
+	set(table, start);
+}
+
+void TextMesh::append(glm::vec2 const &at, std::vector< Vertex > &out) const {
+	//(nearbyint rounds half-to-even, like the quad kernels)
+	int16_t x = int16_t(std::nearbyint(at.x * 8.0f));
+	int16_t y = int16_t(std::nearbyint(at.y * 8.0f));
+	size_t base = out.size();
+	out.resize(base + verts.size());
+	for (size_t v = 0; v < verts.size(); ++v) {
+		out[base + v].Position.x = int16_t(verts[v].Position.x + x);
+		out[base + v].Position.y = int16_t(verts[v].Position.y + y);
+		out[base + v].TexCoord = verts[v].TexCoord;
+	}
+}
+
+TextMesh const &TextCache::get(GlyphTable const &table, std::string const &text) {
+	auto f = meshes.find(text);
+	if (f == meshes.end()) {
+		f = meshes.emplace(text, TextMesh()).first;
+		f->second.set(table, text.c_str());
+	}
+	return f->second;
+}
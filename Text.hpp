@@ -0,0 +1,68 @@
+#pragma once
+
+#include "QuadBatch.hpp"
+#include "Vertex.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Text drawn as quads, one tile-sized glyph per character.
+ *
+ * GlyphTable maps every printable ASCII character to the QuadTemplate of its
+ * glyph (or to none, for characters -- like ' ' -- that only advance).
+ * A TextMesh holds a string laid out at the origin and only lays it out again
+ * when the string changes; TextCache keeps one per (static) string.
+ */
+
+struct GlyphTable {
+	static const char First = ' ';
+	static const char Last = '~';
+	static const uint16_t NoGlyph = 0xffff;
+
+	GlyphTable();
+
+	//draws 'c' with 'quad':
+	void set(char c, QuadTemplate const &quad);
+	//templates index of the glyph for 'c' (NoGlyph for unprintable characters and those without one):
+	uint16_t glyph(char c) const {
+		if (c < First || c > Last) return NoGlyph;
+		return glyphs[c - First];
+	}
+
+	std::vector< QuadTemplate > templates;
+	QuadShape shape = QuadUnitTile; //(QuadGeneral once any glyph isn't a unit tile)
+
+private:
+	uint16_t glyphs[Last - First + 1];
+};
+
+struct TextMesh {
+	//lays out 'text' with its first character at the origin (nothing to do if it is already the text):
+	void set(GlyphTable const &table, char const *text);
+	//lays out 'value' in decimal, without allocating once the mesh has held a number:
+	void set_number(GlyphTable const &table, int32_t value);
+
+	//appends the quads placed with the first character at 'at' to 'out':
+	void append(glm::vec2 const &at, std::vector< Vertex > &out) const;
+
+	std::string text;
+	std::vector< Vertex > verts; //four per drawn glyph, as placed at the origin
+	uint32_t layouts = 0; //times the text was laid out
+
+private:
+	//layout scratch (kept, so re-laying out no longer text doesn't allocate):
+	std::vector< glm::vec2 > glyph_at;
+	std::vector< uint16_t > glyph_index;
+};
+
+struct TextCache {
+	//the mesh for 'text', laid out on first use:
+	TextMesh const &get(GlyphTable const &table, std::string const &text);
+
+	std::unordered_map< std::string, TextMesh > meshes;
+};
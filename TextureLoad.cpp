@@ -0,0 +1,95 @@
+#include "TextureLoad.hpp"
+
+#include <chrono>
+#include <fstream>
+
+TextureLoad::TextureLoad(std::string const &filename, OriginLocation origin) {
+	glGenTextures(1, &texture);
+	size_future = size_promise.get_future();
+	std::promise< bool > decoded_promise;
+	decoded_future = decoded_promise.get_future();
+
+	std::future< uint32_t * > pixels_future = pixels_promise.get_future();
+	//(the promises / futures the worker uses are moved into it)
+	worker = std::thread([this, filename, origin](std::promise< bool > decoded, std::future< uint32_t * > pixels) {
+		bool told_size = false;
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		bool ok = file && load_png(file, nullptr, nullptr, [&](unsigned int w, unsigned int h) {
+			size_promise.set_value(glm::uvec2(w, h));
+			told_size = true;
+			return pixels.get();
+		}, origin);
+		if (!told_size) size_promise.set_value(glm::uvec2(0));
+		decoded.set_value(ok);
+	}, std::move(decoded_promise), std::move(pixels_future));
+}
+
+TextureLoad::~TextureLoad() {
+	if (state == ReadingHeader) {
+		//(the worker may be waiting on memory to decode into)
+		pixels_promise.set_value(nullptr);
+	}
+	worker.join();
+	if (pixel_buffer) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+		if (state == Decoding) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pixel_buffer);
+	}
+}
+
+bool TextureLoad::update() {
+	if (state == ReadingHeader) {
+		if (size_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+		size = size_future.get();
+		uint32_t *pixels = nullptr;
+		if (size.x != 0 && size.y != 0) {
+			glGenBuffers(1, &pixel_buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, 4 * size.x * size.y, NULL, GL_STREAM_DRAW);
+			pixels = reinterpret_cast< uint32_t * >(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, 4 * size.x * size.y,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			if (!pixels) {
+				glDeleteBuffers(1, &pixel_buffer);
+				pixel_buffer = 0;
+			}
+		}
+		pixels_promise.set_value(pixels);
+		state = Decoding;
+	}
+	if (state == Decoding) {
+		if (decoded_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+		failed = !decoded_future.get();
+		if (pixel_buffer) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+			//(unmapping fails if the buffer's contents were lost while mapped)
+			if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE) failed = true;
+			if (!failed) {
+				glBindTexture(GL_TEXTURE_2D, texture);
+				//with a pixel unpack buffer bound, the data pointer is an offset into it:
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLbyte *)0);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			//(GL keeps the storage alive until the transfer out of it is done)
+			glDeleteBuffers(1, &pixel_buffer);
+			pixel_buffer = 0;
+		} else {
+			failed = true;
+		}
+		state = Done;
+	}
+	return true;
+}
+
+void TextureLoad::finish() {
+	if (state == ReadingHeader) size_future.wait();
+	update();
+	if (state == Decoding) decoded_future.wait();
+	update();
+}
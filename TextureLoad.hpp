@@ -0,0 +1,49 @@
+#pragma once
+
+#include "GL.hpp"
+#include "load_save_png.hpp"
+
+#include <glm/glm.hpp>
+
+#include <future>
+#include <string>
+#include <thread>
+
+/*
+ * PNG texture loaded in the background.
+ *
+ * A worker thread decodes the file's rows straight into a mapped
+ * GL_PIXEL_UNPACK_BUFFER, so the pixels are never copied on the CPU. Once
+ * decoding finishes, the texture is filled from that buffer with
+ * glTexImage2D, which returns without waiting for the transfer.
+ *
+ * GL is only touched on the thread that calls update() / finish(). Only the
+ * worker reads the file. update() never blocks, so it can be polled once a
+ * frame to stream in more atlases during play.
+ */
+
+struct TextureLoad {
+	//starts decoding 'filename' ('texture' is created empty right away):
+	TextureLoad(std::string const &filename, OriginLocation origin = LowerLeftOrigin);
+	~TextureLoad();
+	TextureLoad(TextureLoad const &) = delete;
+	TextureLoad &operator=(TextureLoad const &) = delete;
+
+	//does whatever GL work the decode is ready for; returns true once 'texture' is filled (or the load failed):
+	bool update();
+	//blocks until update() would return true:
+	void finish();
+
+	GLuint texture = 0;
+	glm::uvec2 size = glm::uvec2(0); //(known once the worker has read the header)
+	bool failed = false;
+
+private:
+	enum { ReadingHeader, Decoding, Done } state = ReadingHeader;
+	GLuint pixel_buffer = 0;
+	std::promise< glm::uvec2 > size_promise; //worker -> GL thread: image size (0x0 if the header was bad)
+	std::promise< uint32_t * > pixels_promise; //GL thread -> worker: mapped memory to decode into
+	std::future< glm::uvec2 > size_future;
+	std::future< bool > decoded_future; //worker -> GL thread: whether decoding succeeded
+	std::thread worker;
+};
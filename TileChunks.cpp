@@ -0,0 +1,100 @@
+#include "TileChunks.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+TileChunks::TileChunks(glm::ivec2 size_, uint16_t fill_sprite) : size(size_) {
+	if (size.x <= 0 || size.y <= 0) throw std::runtime_error("TileChunks: empty map.");
+	chunks = (size + glm::ivec2(ChunkSize - 1)) / ChunkSize;
+	sprites.assign(size.x * size.y, fill_sprite);
+	counts.assign(chunks.x * chunks.y, 0);
+	dirty.assign(chunks.x * chunks.y, false);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * TilesPerChunk * chunks.x * chunks.y, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+TileChunks::~TileChunks() {
+	glDeleteBuffers(1, &buffer);
+}
+
+void TileChunks::set_sprite(glm::ivec2 at, uint16_t sprite) {
+	uint16_t &current = sprites[at.x * size.y + at.y];
+	if (current == sprite) return;
+	current = sprite;
+	if (all_dirty) return;
+	int c = (at.y / ChunkSize) * chunks.x + (at.x / ChunkSize);
+	if (!dirty[c]) {
+		dirty[c] = true;
+		dirty_list.emplace_back(c);
+	}
+}
+
+GLsizei TileChunks::build_chunk(int cx, int cy, SpriteInstance *out) const {
+	int x_end = std::min(size.x, (cx + 1) * ChunkSize);
+	int y_end = std::min(size.y, (cy + 1) * ChunkSize);
+	GLsizei count = 0;
+	for (int x = cx * ChunkSize; x < x_end; ++x) {
+		for (int y = cy * ChunkSize; y < y_end; ++y) {
+			out[count++] = SpriteInstance(glm::vec2(x, y), sprites[x * size.y + y], glm::u8vec4(0xff));
+		}
+	}
+	return count;
+}
+
+size_t TileChunks::update() {
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	size_t uploaded = 0;
+	if (all_dirty) {
+		//first build: everything in one upload:
+		std::vector< SpriteInstance > data(TilesPerChunk * chunks.x * chunks.y);
+		for (int cy = 0; cy < chunks.y; ++cy) {
+			for (int cx = 0; cx < chunks.x; ++cx) {
+				int c = cy * chunks.x + cx;
+				counts[c] = build_chunk(cx, cy, &data[c * TilesPerChunk]);
+			}
+		}
+		uploaded = sizeof(SpriteInstance) * data.size();
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, uploaded, &data[0]);
+		chunk_rebuilds += chunks.x * chunks.y;
+		all_dirty = false;
+	} else {
+		SpriteInstance data[TilesPerChunk];
+		for (int c : dirty_list) {
+			counts[c] = build_chunk(c % chunks.x, c / chunks.x, data);
+			GLsizeiptr bytes = sizeof(SpriteInstance) * counts[c];
+			glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(SpriteInstance) * TilesPerChunk * c, bytes, data);
+			uploaded += bytes;
+			dirty[c] = false;
+		}
+		chunk_rebuilds += dirty_list.size();
+		dirty_list.clear();
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return uploaded;
+}
+
+void TileChunks::visible(glm::ivec2 min, glm::ivec2 max, std::vector< Range > *out) const {
+	min = glm::max(min, glm::ivec2(0));
+	max = glm::min(max, size);
+	if (min.x >= max.x || min.y >= max.y) return;
+	glm::ivec2 cmin = min / ChunkSize;
+	glm::ivec2 cmax = (max - glm::ivec2(1)) / ChunkSize;
+	for (int cy = cmin.y; cy <= cmax.y; ++cy) {
+		for (int cx = cmin.x; cx <= cmax.x; ++cx) {
+			int c = cy * chunks.x + cx;
+			GLintptr offset = sizeof(SpriteInstance) * TilesPerChunk * c;
+			//(a chunk that starts where the last run ends -- after a full chunk in the same row -- extends it)
+			if (!out->empty() && out->back().offset + GLintptr(sizeof(SpriteInstance)) * out->back().count == offset) {
+				out->back().count += counts[c];
+				continue;
+			}
+			Range range;
+			range.offset = offset;
+			range.count = counts[c];
+			out->emplace_back(range);
+		}
+	}
+}
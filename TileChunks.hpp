@@ -0,0 +1,60 @@
+#pragma once
+
+#include "GL.hpp"
+#include "SpriteInstance.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Background tile layer, cut into ChunkSize x ChunkSize chunks.
+ *
+ * Every chunk owns a fixed run of SpriteInstances in 'buffer'. set_sprite()
+ * only marks the tile's chunk dirty; update() rebuilds and re-uploads just the
+ * dirty chunks. visible() lists the chunks overlapping a tile rectangle, so
+ * drawing costs O(visible chunks) however big the map is. Neighbouring chunks
+ * of a chunk row sit back-to-back in 'buffer', so each visible row comes out
+ * as a single run (one instanced draw).
+ */
+
+struct TileChunks {
+	static const int ChunkSize = 16;
+	static const int TilesPerChunk = ChunkSize * ChunkSize;
+
+	TileChunks(glm::ivec2 size, uint16_t fill_sprite);
+	~TileChunks();
+	TileChunks(TileChunks const &) = delete;
+	TileChunks &operator=(TileChunks const &) = delete;
+
+	void set_sprite(glm::ivec2 at, uint16_t sprite);
+	uint16_t get_sprite(glm::ivec2 at) const { return sprites[at.x * size.y + at.y]; }
+
+	//rebuild and upload every dirty chunk; returns the number of bytes uploaded:
+	size_t update();
+
+	//run of instances within 'buffer':
+	struct Range {
+		GLintptr offset; //in bytes
+		GLsizei count; //in instances
+	};
+	//append the runs of the chunks overlapping tiles [min, max) to 'out' (one per chunk row):
+	void visible(glm::ivec2 min, glm::ivec2 max, std::vector< Range > *out) const;
+
+	glm::ivec2 size; //in tiles
+	glm::ivec2 chunks; //in chunks
+	GLuint buffer = 0;
+
+	uint64_t chunk_rebuilds = 0;
+
+private:
+	//writes chunk (cx,cy)'s instances to 'out'; returns how many:
+	GLsizei build_chunk(int cx, int cy, SpriteInstance *out) const;
+
+	std::vector< uint16_t > sprites; //per tile, indexed [x * size.y + y] like tiles[x][y]
+	std::vector< GLsizei > counts; //per chunk (edge chunks are cropped)
+	std::vector< bool > dirty; //per chunk
+	std::vector< int > dirty_list;
+	bool all_dirty = true;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+//One corner of a CPU-built quad as drawn by the quad program.
+//Sprites sit on the eighth-tile pixel grid and uvs are atlas fractions, so vertices
+// are fixed point; the (always white) color is the quad program's 'tint' uniform.
+struct Vertex {
+	Vertex() = default;
+	Vertex(glm::vec2 const &Position_, glm::vec2 const &TexCoord_) :
+		Position(glm::round(Position_ * 8.0f)), TexCoord(glm::round(TexCoord_ * 65535.0f)) { }
+	glm::i16vec2 Position; //eighths of a tile
+	glm::u16vec2 TexCoord; //unorm16
+};
+static_assert(sizeof(Vertex) == 8, "Vertex is nicely packed.");
@@ -53,11 +53,20 @@ static void user_flush_data(png_structp png_ptr) {
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< uint32_t > *data, OriginLocation origin) {
 	assert(data);
+	data->clear();
+	bool ret = load_png(from, width, height, [data](unsigned int w, unsigned int h) {
+		data->resize(w*h);
+		return data->data();
+	}, origin);
+	if (!ret) data->clear();
+	return ret;
+}
+
+bool load_png(std::istream &from, unsigned int *width, unsigned int *height, std::function< uint32_t *(unsigned int, unsigned int) > const &allocate, OriginLocation origin) {
 	uint32_t local_width, local_height;
 	if (width == nullptr) width = &local_width;
 	if (height == nullptr) height = &local_height;
 	*width = *height = 0;
-	data->clear();
 	//..... load file ......
 	//Load a png file, as per the libpng docs:
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
@@ -79,7 +88,6 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 		LOG_ERROR("  png interal error.");
 		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
 		if (row_pointers != NULL) delete[] row_pointers;
-		data->clear();
 		return false;
 	}
 	//not needed with custom read/write functions: png_init_io(png, NULL);
@@ -103,13 +111,17 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 	//Make sure it's the format we think it is...
 	assert(rowbytes == w*sizeof(uint32_t));
 
-	data->resize(w*h);
+	uint32_t *pixels = allocate(w, h);
+	if (!pixels) {
+		png_destroy_read_struct(&png, &info, NULL);
+		return false;
+	}
 	row_pointers = new png_bytep[h];
 	for (unsigned int r = 0; r < h; ++r) {
 		if (origin == LowerLeftOrigin) {
-			row_pointers[h-1-r] = (png_bytep)(&(*data)[r*w]);
+			row_pointers[h-1-r] = (png_bytep)(&pixels[r*w]);
 		} else {
-			row_pointers[r] = (png_bytep)(&(*data)[r*w]);
+			row_pointers[r] = (png_bytep)(&pixels[r*w]);
 		}
 	}
 	png_read_image(png, row_pointers);
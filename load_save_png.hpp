@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -18,3 +19,6 @@ void save_png(std::string filename, unsigned int width, unsigned int height, uin
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, std::vector< uint32_t > *data, OriginLocation origin = UpperLeftOrigin);
 void save_png(std::ostream &to, unsigned int width, unsigned int height, uint32_t const *data, OriginLocation origin = UpperLeftOrigin);
+
+//decodes straight into the width * height pixels returned by 'allocate(width, height)' (which may return nullptr to give up):
+bool load_png(std::istream &from, unsigned int *width, unsigned int *height, std::function< uint32_t *(unsigned int, unsigned int) > const &allocate, OriginLocation origin = UpperLeftOrigin);
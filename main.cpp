@@ -1,29 +1,147 @@
 #include "load_save_png.hpp"
+#include "StreamBuffer.hpp"
+#include "SpriteInstance.hpp"
+#include "TileChunks.hpp"
+#include "Vertex.hpp"
+#include "QuadBatch.hpp"
+#include "SpriteLayer.hpp"
+#include "SpriteStack.hpp"
+#include "DrawQueue.hpp"
+#include "GLState.hpp"
+#include "Text.hpp"
+#include "TextureLoad.hpp"
+#include "ProgramCache.hpp"
 #include "GL.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 
 static GLuint compile_shader(GLenum type, std::string const &source);
-static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader);
+//('program', if given, is an unlinked program to link into; otherwise one is created)
+static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader, GLuint geometry_shader = 0, GLuint program = 0);
 
 static const int MAX_STEPS = 200;
+static const int MAP_SIZE = 100;
+static const int MAX_SPRITES = 256; //size of the sprite table uniform block
 static std::string hi_message = "o hi play with me";
 
+//how sprites from the sprite table (SpriteInstance data) get turned into quads:
+enum SpritePath {
+	SpritesInstanced, //glDrawArraysInstanced, vertex shader expands a unit quad per instance
+	SpritesPoints, //one GL_POINTS vertex per sprite, geometry shader expands it
+};
+
+//depth order of everything drawn (SpriteInstance::layer); higher layers are in front:
+enum Layer : uint16_t {
+	LayerTiles = 0,
+	LayerWires,
+	LayerSweeper,
+	LayerPlayer,
+	LayerHud,
+	LayerDialog,
+	LayerText,
+	LayerCount
+};
+
 int main(int argc, char **argv) {
 	//Configuration:
 	struct {
 		std::string title = "Game1: Text/Tiles";
 		glm::uvec2 size = glm::uvec2(640, 480);
+		bool stats = false; //print per-frame upload / draw counters about once a second
+		bool bench_chunks = false; //time the chunked tile layer on maps from 100x100 to 4096x4096, then quit
+		bool bench_sprites = false; //report sprites/sec through each sprite path, then quit
+		bool bench_quads = false; //time building text quads on the CPU: per-sprite lambda vs. each batch kernel, then quit
+		SpritePath sprites = SpritesInstanced;
+		bool pixel_framebuffer = true; //render at the art's native resolution, then upscale by a whole number
+		bool palette_atlas = false; //store the atlas as 8-bit palette indices plus a 256-color palette
+		bool program_cache = true; //load linked shader programs from (and save them to) the on-disk cache
+		enum {
+			BackgroundCached, //floor/wall layer rendered to an offscreen texture, redrawn only when needed
+			BackgroundChunks, //visible tile chunks drawn every frame
+			BackgroundTilemap, //one screen quad; the fragment shader looks tiles up in a tile-index texture
+		} background = BackgroundCached;
+		enum {
+			ViewsSingle, //one view, following the player
+			ViewsSplit, //split screen: the player on the left, the sweeper on the right
+			ViewsInset, //picture-in-picture: a zoomed-out overview in the corner
+		} views = ViewsSingle;
 	} config;
 
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--stats") {
+			config.stats = true;
+		} else if (arg == "--bench-chunks") {
+			config.bench_chunks = true;
+		} else if (arg == "--full-resolution") {
+			config.pixel_framebuffer = false;
+		} else if (arg == "--palette-atlas") {
+			config.palette_atlas = true;
+		} else if (arg == "--no-program-cache") {
+			config.program_cache = false;
+		} else if (arg == "--bench-quads") {
+			config.bench_quads = true;
+		} else if (arg == "--bench-sprites") {
+			config.bench_sprites = true;
+		} else if (arg == "--sprites" && argi + 1 < argc) {
+			std::string mode = argv[++argi];
+			if (mode == "instanced") {
+				config.sprites = SpritesInstanced;
+			} else if (mode == "points") {
+				config.sprites = SpritesPoints;
+			} else {
+				std::cerr << "Unknown sprite path '" << mode << "' (expecting 'instanced' or 'points')." << std::endl;
+				return 1;
+			}
+		} else if (arg == "--background" && argi + 1 < argc) {
+			std::string mode = argv[++argi];
+			if (mode == "cached") {
+				config.background = config.BackgroundCached;
+			} else if (mode == "chunks") {
+				config.background = config.BackgroundChunks;
+			} else if (mode == "tilemap") {
+				config.background = config.BackgroundTilemap;
+			} else {
+				std::cerr << "Unknown background mode '" << mode << "' (expecting 'cached', 'chunks', or 'tilemap')." << std::endl;
+				return 1;
+			}
+		} else if (arg == "--views" && argi + 1 < argc) {
+			std::string mode = argv[++argi];
+			if (mode == "single") {
+				config.views = config.ViewsSingle;
+			} else if (mode == "split") {
+				config.views = config.ViewsSplit;
+			} else if (mode == "inset") {
+				config.views = config.ViewsInset;
+			} else {
+				std::cerr << "Unknown views mode '" << mode << "' (expecting 'single', 'split', or 'inset')." << std::endl;
+				return 1;
+			}
+		} else {
+			std::cerr << "Unknown argument '" << arg << "'." << std::endl;
+			std::cerr << "Usage: " << argv[0] << " [--stats] [--bench-chunks] [--bench-sprites] [--bench-quads] [--sprites instanced|points] [--background cached|chunks|tilemap] [--views single|split|inset] [--full-resolution] [--palette-atlas] [--no-program-cache]" << std::endl;
+			return 1;
+		}
+	}
+
 	//------------  initialization ------------
 
+	auto startup_begin = std::chrono::high_resolution_clock::now();
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -87,106 +205,589 @@ int main(int argc, char **argv) {
 	//texture:
 	GLuint tex = 0;
 	glm::uvec2 tex_size = glm::uvec2(0, 0);
-
-	{ //load texture 'tex':
+	//with --palette-atlas, 'tex' holds GL_R8 palette indices and the colors are in 'palette_tex':
+	GLuint palette_tex = 0;
+	static const GLint PaletteUnit = 3; //(palette_tex stays bound to this texture unit)
+
+	//Without --palette-atlas, assets.png is decoded on a worker thread straight into a pixel
+	// buffer while the rest of initialization goes on; 'tex' is filled from it further down.
+	std::unique_ptr< TextureLoad > tex_load;
+	if (!config.palette_atlas) {
+		tex_load.reset(new TextureLoad("assets.png", LowerLeftOrigin));
+		tex = tex_load->texture;
+	} else { //load texture 'tex' (palette quantization needs the pixels here):
 		std::vector< uint32_t > data;
 		if (!load_png("assets.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
 			std::cerr << "Failed to load texture." << std::endl;
 			exit(1);
 		}
+
+		//the art uses only a few colors, so it fits an 8-bit index per texel:
+		std::vector< uint8_t > indices;
+		std::vector< uint32_t > palette;
+		{
+			std::unordered_map< uint32_t, uint8_t > palette_index;
+			indices.reserve(data.size());
+			for (uint32_t texel : data) {
+				//(the color of a fully transparent texel never shows, so they all share an entry)
+				if ((texel & 0xff000000) == 0) texel = 0;
+				auto f = palette_index.find(texel);
+				if (f == palette_index.end()) {
+					if (palette.size() == 256) break;
+					f = palette_index.emplace(texel, uint8_t(palette.size())).first;
+					palette.emplace_back(texel);
+				}
+				indices.emplace_back(f->second);
+			}
+			if (indices.size() != data.size()) {
+				std::cerr << "assets.png has more than 256 colors; using an RGBA atlas instead." << std::endl;
+				config.palette_atlas = false;
+			}
+		}
+
 		//create a texture object:
 		glGenTextures(1, &tex);
 		//bind texture object to GL_TEXTURE_2D:
 		glBindTexture(GL_TEXTURE_2D, tex);
-		//upload texture data from data:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+		//upload texture data from data (or its palette indices):
+		if (config.palette_atlas) {
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, tex_size.x, tex_size.y, 0, GL_RED, GL_UNSIGNED_BYTE, &indices[0]);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		} else {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+		}
 		//set texture sampling parameters:
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		if (config.palette_atlas) { //palette texture, one texel per index:
+			std::cout << "Palette atlas: " << palette.size() << " colors, "
+				<< indices.size() / 1024 << " KiB of indices (instead of " << 4 * data.size() / 1024 << " KiB of RGBA)." << std::endl;
+			palette.resize(256, 0);
+			glGenTextures(1, &palette_tex);
+			glActiveTexture(GL_TEXTURE0 + PaletteUnit);
+			glBindTexture(GL_TEXTURE_2D, palette_tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &palette[0]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glActiveTexture(GL_TEXTURE0);
+		}
 	}
 
+	//The worker waits for the GL thread to map its pixel buffer, which TextureLoad::update()
+	// does once the header is read; so it is polled between the initialization stages below:
+	auto poll_texture_load = [&tex_load]() {
+		if (tex_load) tex_load->update();
+	};
+	poll_texture_load();
+
+	//Sprites may come from several atlas textures; instanced draws are batched per atlas
+	// (see DrawQueue.hpp). Everything in textures.blob is cut from assets.png, atlas 0:
+	std::vector< GLuint > atlases;
+	atlases.emplace_back(tex);
+
+	//how fragment shaders read the atlas 'tex' (as atlas_color(texel)); a palette lookup with --palette-atlas:
+	std::string const atlas_glsl = config.palette_atlas ?
+		"uniform sampler2D tex; //palette indices, in red\n"
+		"uniform sampler2D palette; //256 x 1 colors\n"
+		"vec4 atlas_color(vec4 texel) {\n"
+		"	return texelFetch(palette, ivec2(int(texel.r * 255.0 + 0.5), 0), 0);\n"
+		"}\n"
+		:
+		"uniform sampler2D tex;\n"
+		"vec4 atlas_color(vec4 texel) {\n"
+		"	return texel;\n"
+		"}\n";
+
+	//Linked programs are kept in an on-disk cache (see ProgramCache.hpp), so later launches
+	// skip compiling and linking:
+	std::unique_ptr< ProgramCache > program_cache;
+	if (config.program_cache) {
+		char *pref_path = SDL_GetPrefPath("15-466", "game1");
+		if (pref_path) {
+			program_cache.reset(new ProgramCache(pref_path, SDL_GL_GetProcAddress));
+			SDL_free(pref_path);
+		}
+	}
+	double program_build_seconds = 0.0; //(reported by --stats)
+
+	//a linked program with these shaders (geometry_source may be empty), from the cache if it has it:
+	auto build_program = [&](std::string const &vertex_source, std::string const &fragment_source, std::string const &geometry_source) {
+		auto before = std::chrono::high_resolution_clock::now();
+		std::string key;
+		GLuint program = 0;
+		if (program_cache) {
+			key = program_cache->key(vertex_source + '\0' + fragment_source + '\0' + geometry_source);
+			program = program_cache->load(key);
+		}
+		if (!program) {
+			GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+			GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+			GLuint geometry_shader = (geometry_source.empty() ? 0 : compile_shader(GL_GEOMETRY_SHADER, geometry_source));
+			program = glCreateProgram();
+			if (program_cache) program_cache->prepare(program);
+			program = link_program(fragment_shader, vertex_shader, geometry_shader, program);
+			if (program_cache) program_cache->store(key, program);
+		}
+		program_build_seconds += std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count();
+		return program;
+	};
+
 	//shader program:
 	GLuint program = 0;
 	GLuint program_Position = 0;
 	GLuint program_TexCoord = 0;
-	GLuint program_Color = 0;
 	GLuint program_mvp = 0;
 	GLuint program_tex = 0;
+	GLuint program_tint = 0;
+	GLuint program_layer = 0;
+	GLuint program_paletted = 0;
+	GLuint program_palette = 0;
+
+	//maps a Layer to clip-space depth (layer 0 is farthest, still in front of the cleared depth):
+	std::string const layer_depth_glsl =
+		"float layer_depth(uint layer) {\n"
+		"	return 1.0 - float(layer + 1u) / 128.0;\n"
+		"}\n";
+
 	{ //compile shader program:
-		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
+		std::string const vertex_source =
 			"#version 330\n"
+			+ layer_depth_glsl +
 			"uniform mat4 mvp;\n"
-			"in vec4 Position;\n"
+			"uniform vec4 tint;\n"
+			"uniform uint layer;\n"
+			"in vec2 Position; //in eighths of a tile\n"
 			"in vec2 TexCoord;\n"
-			"in vec4 Color;\n"
 			"out vec2 texCoord;\n"
 			"out vec4 color;\n"
 			"void main() {\n"
-			"	gl_Position = mvp * Position;\n"
-			"	color = Color;\n"
+			"	gl_Position = mvp * vec4(Position / 8.0, 0.0, 1.0);\n"
+			"	gl_Position.z = layer_depth(layer);\n"
+			"	color = tint;\n"
 			"	texCoord = TexCoord;\n"
-			"}\n"
-		);
+			"}\n";
 
-		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
+		std::string const fragment_source =
 			"#version 330\n"
-			"uniform sampler2D tex;\n"
+			+ atlas_glsl +
+			"uniform bool paletted; //(false when drawing the background cache, which holds colors)\n"
 			"in vec4 color;\n"
 			"in vec2 texCoord;\n"
 			"out vec4 fragColor;\n"
 			"void main() {\n"
-			"	fragColor = texture(tex, texCoord) * color;\n"
-			"}\n"
-		);
+			"	vec4 texel = texture(tex, texCoord);\n"
+			"	fragColor = (paletted ? atlas_color(texel) : texel) * color;\n"
+			"}\n";
 
-		program = link_program(fragment_shader, vertex_shader);
+		program = build_program(vertex_source, fragment_source, "");
 
 		//look up attribute locations:
 		program_Position = glGetAttribLocation(program, "Position");
 		if (program_Position == -1U) throw std::runtime_error("no attribute named Position");
 		program_TexCoord = glGetAttribLocation(program, "TexCoord");
 		if (program_TexCoord == -1U) throw std::runtime_error("no attribute named TexCoord");
-		program_Color = glGetAttribLocation(program, "Color");
-		if (program_Color == -1U) throw std::runtime_error("no attribute named Color");
 
 		//look up uniform locations:
 		program_mvp = glGetUniformLocation(program, "mvp");
 		if (program_mvp == -1U) throw std::runtime_error("no uniform named mvp");
 		program_tex = glGetUniformLocation(program, "tex");
 		if (program_tex == -1U) throw std::runtime_error("no uniform named tex");
+		program_tint = glGetUniformLocation(program, "tint");
+		if (program_tint == -1U) throw std::runtime_error("no uniform named tint");
+		program_layer = glGetUniformLocation(program, "layer");
+		if (program_layer == -1U) throw std::runtime_error("no uniform named layer");
+		//(these two are only there with --palette-atlas; setting a -1 location does nothing)
+		program_paletted = glGetUniformLocation(program, "paletted");
+		program_palette = glGetUniformLocation(program, "palette");
+
+		//uniforms that never change (a program keeps its uniform values, so set them once):
+		glUseProgram(program);
+		glUniform1i(program_tex, 0);
+		glUniform1i(program_palette, PaletteUnit);
+		glUniform1i(program_paletted, GL_TRUE);
+		glUniform4f(program_tint, 1.0f, 1.0f, 1.0f, 1.0f);
 	}
 
-	//vertex buffer:
-	GLuint buffer = 0;
-	{ //create vertex buffer
-		glGenBuffers(1, &buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	//the sprite table, shared by the sprite programs (a uniform block holding each sprite's baked quad):
+	std::string const sprite_table_glsl =
+		"#define MAX_SPRITES " + std::to_string(MAX_SPRITES) + "\n"
+		"layout(std140) uniform SpriteTable {\n"
+		"	vec4 sprite_at[MAX_SPRITES]; //bottom-left, top-right corner offsets (tiles)\n"
+		"	vec4 sprite_uv[MAX_SPRITES]; //texture coordinates at those corners\n"
+		"	vec4 sprite_anim[MAX_SPRITES]; //frame count, frames per second, uv step between frames\n"
+		"};\n"
+		"uniform float time; //seconds of play\n"
+		"//how far this frame of 'sprite' sits from its first frame:\n"
+		"vec2 frame_offset(uint sprite) {\n"
+		"	vec4 anim = sprite_anim[sprite];\n"
+		"	return anim.zw * mod(floor(time * anim.y), anim.x);\n"
+		"}\n";
+
+	std::string const sprite_fragment_glsl =
+		"#version 330\n"
+		+ atlas_glsl +
+		"in vec4 color;\n"
+		"in vec2 texCoord;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	fragColor = atlas_color(texture(tex, texCoord)) * color;\n"
+		"}\n";
+
+	//instanced sprite program:
+	//Each instance is (position, sprite index, tint); the vertex shader expands a unit quad
+	// from the sprite table.
+	GLuint sprite_program = 0;
+	GLuint sprite_program_At = 0;
+	GLuint sprite_program_Sprite = 0;
+	GLuint sprite_program_Layer = 0;
+	GLuint sprite_program_Tint = 0;
+	GLuint sprite_program_mvp = 0;
+	GLuint sprite_program_time = 0;
+	GLuint sprite_program_tex = 0;
+	GLuint sprite_program_SpriteTable = 0;
+	poll_texture_load();
+
+	{ //compile instanced sprite program:
+		std::string const vertex_source =
+			"#version 330\n"
+			+ sprite_table_glsl + layer_depth_glsl +
+			"uniform mat4 mvp;\n"
+			"in vec2 At; //in eighths of a tile\n"
+			"in uint Sprite;\n"
+			"in uint Layer;\n"
+			"in vec4 Tint;\n"
+			"out vec2 texCoord;\n"
+			"out vec4 color;\n"
+			"void main() {\n"
+			"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+			"	vec4 at = sprite_at[Sprite];\n"
+			"	vec4 uv = sprite_uv[Sprite];\n"
+			"	gl_Position = mvp * vec4(At / 8.0 + mix(at.xy, at.zw, corner), 0.0, 1.0);\n"
+			"	gl_Position.z = layer_depth(Layer);\n"
+			"	texCoord = mix(uv.xy, uv.zw, corner) + frame_offset(Sprite);\n"
+			"	color = Tint;\n"
+			"}\n";
+
+		std::string const &fragment_source = sprite_fragment_glsl;
+
+		sprite_program = build_program(vertex_source, fragment_source, "");
+
+		//look up attribute locations:
+		sprite_program_At = glGetAttribLocation(sprite_program, "At");
+		if (sprite_program_At == -1U) throw std::runtime_error("no attribute named At");
+		sprite_program_Sprite = glGetAttribLocation(sprite_program, "Sprite");
+		if (sprite_program_Sprite == -1U) throw std::runtime_error("no attribute named Sprite");
+		sprite_program_Layer = glGetAttribLocation(sprite_program, "Layer");
+		if (sprite_program_Layer == -1U) throw std::runtime_error("no attribute named Layer");
+		sprite_program_Tint = glGetAttribLocation(sprite_program, "Tint");
+		if (sprite_program_Tint == -1U) throw std::runtime_error("no attribute named Tint");
+
+		//look up uniform locations:
+		sprite_program_mvp = glGetUniformLocation(sprite_program, "mvp");
+		if (sprite_program_mvp == -1U) throw std::runtime_error("no uniform named mvp");
+		sprite_program_time = glGetUniformLocation(sprite_program, "time");
+		if (sprite_program_time == -1U) throw std::runtime_error("no uniform named time");
+		sprite_program_tex = glGetUniformLocation(sprite_program, "tex");
+		if (sprite_program_tex == -1U) throw std::runtime_error("no uniform named tex");
+		sprite_program_SpriteTable = glGetUniformBlockIndex(sprite_program, "SpriteTable");
+		if (sprite_program_SpriteTable == GL_INVALID_INDEX) throw std::runtime_error("no uniform block named SpriteTable");
+		glUniformBlockBinding(sprite_program, sprite_program_SpriteTable, 0);
+		glUseProgram(sprite_program);
+		glUniform1i(sprite_program_tex, 0);
+		glUniform1i(glGetUniformLocation(sprite_program, "palette"), PaletteUnit);
 	}
 
-	struct Vertex {
-		Vertex(glm::vec2 const &Position_, glm::vec2 const &TexCoord_, glm::u8vec4 const &Color_) :
-			Position(Position_), TexCoord(TexCoord_), Color(Color_) { }
-		glm::vec2 Position;
-		glm::vec2 TexCoord;
-		glm::u8vec4 Color;
+	//point sprite program:
+	//Same SpriteInstance data, but sent as one GL_POINTS vertex per sprite;
+	// the geometry shader looks the sprite up in the sprite table and emits its quad.
+	GLuint point_program = 0;
+	GLuint point_program_At = 0;
+	GLuint point_program_Sprite = 0;
+	GLuint point_program_Layer = 0;
+	GLuint point_program_Tint = 0;
+	GLuint point_program_mvp = 0;
+	GLuint point_program_time = 0;
+	GLuint point_program_tex = 0;
+	GLuint point_program_SpriteTable = 0;
+	poll_texture_load();
+
+	{ //compile point sprite program:
+		std::string const vertex_source =
+			"#version 330\n"
+			"in vec2 At; //in eighths of a tile\n"
+			"in uint Sprite;\n"
+			"in uint Layer;\n"
+			"in vec4 Tint;\n"
+			"out vec2 at;\n"
+			"flat out uint sprite;\n"
+			"flat out uint layer;\n"
+			"out vec4 tint;\n"
+			"void main() {\n"
+			"	at = At / 8.0;\n"
+			"	sprite = Sprite;\n"
+			"	layer = Layer;\n"
+			"	tint = Tint;\n"
+			"}\n";
+
+		std::string const geometry_source =
+			"#version 330\n"
+			+ sprite_table_glsl + layer_depth_glsl +
+			"layout(points) in;\n"
+			"layout(triangle_strip, max_vertices = 4) out;\n"
+			"uniform mat4 mvp;\n"
+			"in vec2 at[];\n"
+			"flat in uint sprite[];\n"
+			"flat in uint layer[];\n"
+			"in vec4 tint[];\n"
+			"out vec2 texCoord;\n"
+			"out vec4 color;\n"
+			"void main() {\n"
+			"	vec4 rect = sprite_at[sprite[0]];\n"
+			"	vec4 uv = sprite_uv[sprite[0]];\n"
+			"	uv += frame_offset(sprite[0]).xyxy;\n"
+			"	for (int i = 0; i < 4; ++i) {\n"
+			"		vec2 corner = vec2(i & 1, i >> 1);\n"
+			"		gl_Position = mvp * vec4(at[0] + mix(rect.xy, rect.zw, corner), 0.0, 1.0);\n"
+			"		gl_Position.z = layer_depth(layer[0]);\n"
+			"		texCoord = mix(uv.xy, uv.zw, corner);\n"
+			"		color = tint[0];\n"
+			"		EmitVertex();\n"
+			"	}\n"
+			"	EndPrimitive();\n"
+			"}\n";
+
+		std::string const &fragment_source = sprite_fragment_glsl;
+
+		point_program = build_program(vertex_source, fragment_source, geometry_source);
+
+		//look up attribute locations:
+		point_program_At = glGetAttribLocation(point_program, "At");
+		if (point_program_At == -1U) throw std::runtime_error("no attribute named At");
+		point_program_Sprite = glGetAttribLocation(point_program, "Sprite");
+		if (point_program_Sprite == -1U) throw std::runtime_error("no attribute named Sprite");
+		point_program_Layer = glGetAttribLocation(point_program, "Layer");
+		if (point_program_Layer == -1U) throw std::runtime_error("no attribute named Layer");
+		point_program_Tint = glGetAttribLocation(point_program, "Tint");
+		if (point_program_Tint == -1U) throw std::runtime_error("no attribute named Tint");
+
+		//look up uniform locations:
+		point_program_mvp = glGetUniformLocation(point_program, "mvp");
+		if (point_program_mvp == -1U) throw std::runtime_error("no uniform named mvp");
+		point_program_time = glGetUniformLocation(point_program, "time");
+		if (point_program_time == -1U) throw std::runtime_error("no uniform named time");
+		point_program_tex = glGetUniformLocation(point_program, "tex");
+		if (point_program_tex == -1U) throw std::runtime_error("no uniform named tex");
+		point_program_SpriteTable = glGetUniformBlockIndex(point_program, "SpriteTable");
+		if (point_program_SpriteTable == GL_INVALID_INDEX) throw std::runtime_error("no uniform block named SpriteTable");
+		glUniformBlockBinding(point_program, point_program_SpriteTable, 0);
+		glUseProgram(point_program);
+		glUniform1i(point_program_tex, 0);
+		glUniform1i(glGetUniformLocation(point_program, "palette"), PaletteUnit);
+	}
+
+	//vertex stream (ring buffer for the per-frame text quads):
+	std::unique_ptr< StreamBuffer > vertex_stream(new StreamBuffer(64 * 1024));
+
+	//tilemap program:
+	//Draws the whole visible background as one screen-covering quad; the fragment shader
+	// finds each pixel's tile in 'tile_map' (sprite index per texel) and that sprite's
+	// atlas rectangle in 'sprite_rects', then fetches the atlas texel directly.
+	GLuint tilemap_program = 0;
+	GLuint tilemap_program_view_min = 0;
+	GLuint tilemap_program_view_max = 0;
+	GLuint tilemap_program_tile_offset = 0;
+	GLuint tilemap_program_tex = 0;
+	GLuint tilemap_program_tile_map = 0;
+	GLuint tilemap_program_sprite_rects = 0;
+	GLuint tilemap_program_time = 0;
+	poll_texture_load();
+
+	{ //compile tilemap program:
+		std::string const vertex_source =
+			"#version 330\n"
+			+ layer_depth_glsl +
+			"uniform vec2 view_min;\n"
+			"uniform vec2 view_max;\n"
+			"out vec2 world;\n"
+			"void main() {\n"
+			"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+			"	gl_Position = vec4(2.0 * corner - 1.0, layer_depth(0u), 1.0); //(LayerTiles)\n"
+			"	world = mix(view_min, view_max, corner);\n"
+			"}\n";
+
+		std::string const fragment_source =
+			"#version 330\n"
+			+ atlas_glsl +
+			"uniform vec2 tile_offset; //where tile (0,0)'s quad starts\n"
+			"uniform usampler2D tile_map;\n"
+			"uniform sampler2D sprite_rects; //per sprite: min.xy, max.xy in atlas texels; below that, frame count, frames per second, texel step between frames\n"
+			"uniform float time; //seconds of play\n"
+			"in vec2 world;\n"
+			"out vec4 fragColor;\n"
+			"void main() {\n"
+			"	vec2 at = world - tile_offset;\n"
+			"	ivec2 tile = ivec2(floor(at));\n"
+			"	if (any(lessThan(tile, ivec2(0))) || any(greaterThanEqual(tile, textureSize(tile_map, 0)))) discard;\n"
+			"	uint sprite = texelFetch(tile_map, tile, 0).r;\n"
+			"	vec4 rect = texelFetch(sprite_rects, ivec2(int(sprite), 0), 0);\n"
+			"	ivec2 texel = ivec2(floor(mix(rect.xy, rect.zw, fract(at))));\n"
+			"	texel = clamp(texel, ivec2(rect.xy), ivec2(rect.zw) - 1);\n"
+			"	vec4 anim = texelFetch(sprite_rects, ivec2(int(sprite), 1), 0);\n"
+			"	texel += ivec2(anim.zw * mod(floor(time * anim.y), anim.x));\n"
+			"	fragColor = atlas_color(texelFetch(tex, texel, 0));\n"
+			"}\n";
+
+		tilemap_program = build_program(vertex_source, fragment_source, "");
+
+		//look up uniform locations:
+		tilemap_program_view_min = glGetUniformLocation(tilemap_program, "view_min");
+		if (tilemap_program_view_min == -1U) throw std::runtime_error("no uniform named view_min");
+		tilemap_program_view_max = glGetUniformLocation(tilemap_program, "view_max");
+		if (tilemap_program_view_max == -1U) throw std::runtime_error("no uniform named view_max");
+		tilemap_program_tile_offset = glGetUniformLocation(tilemap_program, "tile_offset");
+		if (tilemap_program_tile_offset == -1U) throw std::runtime_error("no uniform named tile_offset");
+		tilemap_program_tex = glGetUniformLocation(tilemap_program, "tex");
+		if (tilemap_program_tex == -1U) throw std::runtime_error("no uniform named tex");
+		tilemap_program_tile_map = glGetUniformLocation(tilemap_program, "tile_map");
+		if (tilemap_program_tile_map == -1U) throw std::runtime_error("no uniform named tile_map");
+		tilemap_program_sprite_rects = glGetUniformLocation(tilemap_program, "sprite_rects");
+		if (tilemap_program_sprite_rects == -1U) throw std::runtime_error("no uniform named sprite_rects");
+		tilemap_program_time = glGetUniformLocation(tilemap_program, "time");
+		if (tilemap_program_time == -1U) throw std::runtime_error("no uniform named time");
+
+		//texture units never change:
+		glUseProgram(tilemap_program);
+		glUniform1i(tilemap_program_tex, 0);
+		glUniform1i(tilemap_program_tile_map, 1);
+		glUniform1i(tilemap_program_sprite_rects, 2);
+		glUniform1i(glGetUniformLocation(tilemap_program, "palette"), PaletteUnit);
+	}
+
+	//quad index buffer:
+	//Sprites are emitted as four-vertex quads and drawn as GL_TRIANGLES through this
+	// shared index buffer. It holds indices for quad_index_capacity quads and only ever grows.
+	static const int VertsPerSprite = 4;
+	static const int IndicesPerSprite = 6;
+	GLuint quad_index_buffer = 0;
+	GLuint quad_index_capacity = 0;
+	glGenBuffers(1, &quad_index_buffer);
+	auto reserve_quad_indices = [&quad_index_buffer, &quad_index_capacity](GLuint quads) {
+		if (quads <= quad_index_capacity) return;
+		GLuint capacity = std::max(quads, 2 * quad_index_capacity);
+		std::vector< GLuint > indices;
+		indices.reserve(capacity * IndicesPerSprite);
+		for (GLuint q = 0; q < capacity; ++q) {
+			//corners are emitted bottom-left, top-left, bottom-right, top-right:
+			indices.emplace_back(4 * q + 0);
+			indices.emplace_back(4 * q + 1);
+			indices.emplace_back(4 * q + 2);
+			indices.emplace_back(4 * q + 2);
+			indices.emplace_back(4 * q + 1);
+			indices.emplace_back(4 * q + 3);
+		}
+		//(upload through the copy target so the bound vao's element binding is left alone)
+		glBindBuffer(GL_COPY_WRITE_BUFFER, quad_index_buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		quad_index_capacity = capacity;
+	};
+	reserve_quad_indices(1024);
+
+	//sets up Vertex attribute pointers (starting 'base' bytes into the buffer bound to GL_ARRAY_BUFFER)
+	// and attaches the quad index buffer to the bound vao:
+	auto bind_vertex_attributes = [&program_Position, &program_TexCoord, &quad_index_buffer](GLintptr base) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_index_buffer);
+		glVertexAttribPointer(program_Position, 2, GL_SHORT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + base);
+		glVertexAttribPointer(program_TexCoord, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + base + offsetof(Vertex, TexCoord));
+		glEnableVertexAttribArray(program_Position);
+		glEnableVertexAttribArray(program_TexCoord);
 	};
-	static_assert(sizeof(Vertex) == 20, "Vertex is nicely packed.");
 
 	//vertex array object:
 	GLuint vao = 0;
+	poll_texture_load();
+
 	{ //create vao and set up binding:
 		glGenVertexArrays(1, &vao);
 		glBindVertexArray(vao);
-		glVertexAttribPointer(program_Position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0);
-		glVertexAttribPointer(program_TexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + sizeof(glm::vec2));
-		glVertexAttribPointer(program_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + sizeof(glm::vec2) + sizeof(glm::vec2));
-		glEnableVertexAttribArray(program_Position);
-		glEnableVertexAttribArray(program_TexCoord);
-		glEnableVertexAttribArray(program_Color);
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_stream->buffer);
+		bind_vertex_attributes(0);
 	}
 
+	//sets up SpriteInstance attribute pointers for 'path' (starting 'base' bytes into the buffer bound to GL_ARRAY_BUFFER);
+	// per instance for the instanced program, per vertex for the point program:
+	auto bind_instance_attributes = [&](SpritePath path, GLintptr base) {
+		GLuint At = (path == SpritesPoints ? point_program_At : sprite_program_At);
+		GLuint Sprite = (path == SpritesPoints ? point_program_Sprite : sprite_program_Sprite);
+		GLuint Layer = (path == SpritesPoints ? point_program_Layer : sprite_program_Layer);
+		GLuint Tint = (path == SpritesPoints ? point_program_Tint : sprite_program_Tint);
+		GLuint divisor = (path == SpritesPoints ? 0 : 1);
+		glVertexAttribPointer(At, 2, GL_SHORT, GL_FALSE, sizeof(SpriteInstance), (GLbyte *)0 + base);
+		glVertexAttribIPointer(Sprite, 1, GL_UNSIGNED_SHORT, sizeof(SpriteInstance), (GLbyte *)0 + base + offsetof(SpriteInstance, sprite));
+		glVertexAttribIPointer(Layer, 1, GL_UNSIGNED_SHORT, sizeof(SpriteInstance), (GLbyte *)0 + base + offsetof(SpriteInstance, layer));
+		glVertexAttribPointer(Tint, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteInstance), (GLbyte *)0 + base + offsetof(SpriteInstance, tint));
+		glVertexAttribDivisor(At, divisor);
+		glVertexAttribDivisor(Sprite, divisor);
+		glVertexAttribDivisor(Layer, divisor);
+		glVertexAttribDivisor(Tint, divisor);
+		glEnableVertexAttribArray(At);
+		glEnableVertexAttribArray(Sprite);
+		glEnableVertexAttribArray(Layer);
+		glEnableVertexAttribArray(Tint);
+	};
+
+	//instance stream (ring buffer for the per-frame sprites):
+	std::unique_ptr< StreamBuffer > instance_stream(new StreamBuffer(64 * 1024));
+	GLuint instance_vao = 0; //SpriteInstance attributes for SpritesInstanced
+	GLuint point_vao = 0; //... for SpritesPoints
+	{ //create instance vaos:
+		glBindBuffer(GL_ARRAY_BUFFER, instance_stream->buffer);
+		glGenVertexArrays(1, &instance_vao);
+		glBindVertexArray(instance_vao);
+		bind_instance_attributes(SpritesInstanced, 0);
+		glGenVertexArrays(1, &point_vao);
+		glBindVertexArray(point_vao);
+		bind_instance_attributes(SpritesPoints, 0);
+	}
+
+	//per-frame program / vao / buffer / texture / blend / depth changes go through here,
+	// which leaves out the ones that wouldn't change anything (see GLState.hpp):
+	GLState gl_state;
+
+	//seconds of play, which the shaders pick animation frames from (advanced by each frame's 'elapsed'):
+	float animation_time = 0.0f;
+
+	//makes the program for 'path' current, drawing with projection 'mvp':
+	auto use_sprite_program = [&](SpritePath path, glm::mat4 const &mvp) {
+		if (path == SpritesPoints) {
+			gl_state.use_program(point_program);
+			glUniformMatrix4fv(point_program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+			glUniform1f(point_program_time, animation_time);
+		} else {
+			gl_state.use_program(sprite_program);
+			glUniformMatrix4fv(sprite_program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+			glUniform1f(sprite_program_time, animation_time);
+		}
+	};
+
+	//draws 'count' SpriteInstances starting 'offset' bytes into 'buffer' (after use_sprite_program(path, ...)):
+	auto draw_sprite_instances = [&](SpritePath path, GLuint buffer, GLintptr offset, GLsizei count) {
+		gl_state.bind_vertex_array(path == SpritesPoints ? point_vao : instance_vao);
+		gl_state.bind_array_buffer(buffer);
+		bind_instance_attributes(path, offset);
+		if (path == SpritesPoints) {
+			glDrawArrays(GL_POINTS, 0, count);
+		} else {
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+		}
+	};
+
+	poll_texture_load();
+
 	//------------ sprite info ------------
 	struct SpriteInfo {
 		int object_id;
@@ -214,7 +815,7 @@ int main(int argc, char **argv) {
 	};
 
 
-	Tile tiles[100][100]; //background tiles
+	Tile tiles[MAP_SIZE][MAP_SIZE]; //background tiles
 	
 	//------- SpriteInfo loader ----------
 	struct Header {
@@ -335,8 +936,180 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	for (int i = 0; i < 100; i++) {
-		for (int j = 0; j < 100; j++) {
+	if (sprites.size() > size_t(MAX_SPRITES)) {
+		throw std::runtime_error("More sprites in textures.blob than fit in the sprite table.");
+	}
+
+	poll_texture_load();
+
+	//------------ baked sprite quads ------------
+	//Everything about a sprite's quad that does not depend on where it is drawn,
+	// worked out once at load (normalized, v-flipped uvs and corner offsets in tiles):
+	struct SpriteQuad {
+		glm::vec2 min_at; //bottom-left corner, relative to the sprite's position
+		glm::vec2 max_at; //top-right corner
+		glm::vec2 min_uv; //texture coordinate at min_at
+		glm::vec2 max_uv; //texture coordinate at max_at
+	};
+
+	auto bake_quad = [&header](SpriteInfo const &sprite) {
+		SpriteQuad quad;
+		quad.min_at.x = (sprite.min_uv.x - sprite.origin.x) / 8;
+		quad.min_at.y = (sprite.origin.y - sprite.max_uv.y) / 8;
+		quad.max_at.x = (sprite.max_uv.x - sprite.origin.x) / 8;
+		quad.max_at.y = (sprite.origin.y - sprite.min_uv.y) / 8;
+		quad.min_uv.x = sprite.min_uv.x / header.text_size_x;
+		quad.min_uv.y = 1.0f - sprite.max_uv.y / header.text_size_y;
+		quad.max_uv.x = sprite.max_uv.x / header.text_size_x;
+		quad.max_uv.y = 1.0f - sprite.min_uv.y / header.text_size_y;
+		return quad;
+	};
+
+	std::vector< SpriteQuad > sprite_quads; //parallel to 'sprites', then the animated sprites below
+	for (auto const &sprite : sprites) {
+		sprite_quads.emplace_back(bake_quad(sprite));
+	}
+
+	//glyphs are 8x8 cells along the number and alphabet strips:
+	auto bake_glyph = [&bake_quad](SpriteInfo const &strip, int index) {
+		SpriteInfo glyph;
+		glyph.min_uv = strip.min_uv + glm::vec2(8 * index, 0);
+		glyph.max_uv = strip.min_uv + glm::vec2(8 * index + 8, 8);
+		glyph.origin = strip.origin + glm::vec2(8 * index, 0);
+		return bake_quad(glyph);
+	};
+	std::vector< SpriteQuad > digit_quads; //'0' - '9'
+	for (int d = 0; d < 10; ++d) {
+		digit_quads.emplace_back(bake_glyph(*numbers.sprite, d));
+	}
+	std::vector< SpriteQuad > letter_quads; //'a' - 'z'
+	for (int l = 0; l < 26; ++l) {
+		letter_quads.emplace_back(bake_glyph(*alphabets.sprite, l));
+	}
+
+	//------------ animated sprites ------------
+	//An animated sprite is its own sprite table entry (after those from textures.blob) whose
+	// frames sit 'stride' apart in the atlas; the shaders pick the frame from the time, so
+	// animating costs no CPU work or uploads after load. (Animated background tiles need
+	// --background chunks or tilemap; the cached background always draws first frames.)
+	struct SpriteAnimation {
+		float frames = 1.0f;
+		float frames_per_second = 0.0f;
+		glm::vec2 stride = glm::vec2(0.0f); //between frames, in atlas texels (x right, y down, like textures.blob)
+	};
+	std::vector< SpriteAnimation > sprite_animations(sprite_quads.size()); //parallel to 'sprite_quads'
+
+	//adds an animated copy of 'object' to the sprite table, returning its index:
+	auto add_animated_sprite = [&](Object const &object, uint32_t frames, float frames_per_second, glm::vec2 const &stride) {
+		sprite_quads.emplace_back(sprite_quads[object.sprite - sprites.begin()]);
+		SpriteAnimation animation;
+		animation.frames = float(frames);
+		animation.frames_per_second = frames_per_second;
+		animation.stride = stride;
+		sprite_animations.emplace_back(animation);
+		return uint16_t(sprite_quads.size() - 1);
+	};
+
+	//the wire's plugged-in end blinks (the atlas cell left of the vertical wire is empty):
+	uint16_t wire_socket = add_animated_sprite(wire_vert, 2, 2.0f, glm::vec2(-8.0f, 0.0f));
+
+	if (sprite_quads.size() > size_t(MAX_SPRITES)) {
+		throw std::runtime_error("More sprites (with animated ones) than fit in the sprite table.");
+	}
+
+	//frame step in normalized (v-flipped) texture coordinates, like SpriteQuad's uvs:
+	auto stride_uv = [&header](SpriteAnimation const &animation) {
+		return glm::vec2(animation.stride.x / header.text_size_x, -animation.stride.y / header.text_size_y);
+	};
+
+	//sprite table uniform buffer, laid out as the std140 SpriteTable block:
+	GLuint sprite_table_buffer = 0;
+	{ //upload sprite table:
+		std::vector< glm::vec4 > table(3 * MAX_SPRITES, glm::vec4(0.0f));
+		for (size_t s = 0; s < MAX_SPRITES; ++s) {
+			table[2 * MAX_SPRITES + s] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f); //(one still frame)
+		}
+		for (size_t s = 0; s < sprite_quads.size(); ++s) {
+			table[s] = glm::vec4(sprite_quads[s].min_at, sprite_quads[s].max_at);
+			table[MAX_SPRITES + s] = glm::vec4(sprite_quads[s].min_uv, sprite_quads[s].max_uv);
+			SpriteAnimation const &animation = sprite_animations[s];
+			table[2 * MAX_SPRITES + s] = glm::vec4(glm::vec2(animation.frames, animation.frames_per_second), stride_uv(animation));
+		}
+		glGenBuffers(1, &sprite_table_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, sprite_table_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::vec4) * table.size(), &table[0], GL_STATIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, 0, sprite_table_buffer);
+	}
+
+	//sprites with no translucent texels, drawn in the opaque pass (depth tested, no blending):
+	std::vector< bool > sprite_opaque(sprite_quads.size(), false); //parallel to 'sprite_quads'
+	for (Object const *object : {&floor, &wall, &wall_dark}) {
+		sprite_opaque[object->sprite - sprites.begin()] = true;
+	}
+
+	std::vector< uint8_t > sprite_atlas(sprite_quads.size(), 0); //parallel to 'sprite_quads'; index into 'atlases'
+
+	//runs that are drawn together (the tiles, the wire) must come from one atlas:
+	auto shared_atlas = [&sprites, &sprite_atlas](std::initializer_list< Object const * > objects) {
+		uint8_t atlas = sprite_atlas[(*objects.begin())->sprite - sprites.begin()];
+		for (Object const *object : objects) {
+			if (sprite_atlas[object->sprite - sprites.begin()] != atlas) {
+				throw std::runtime_error("Sprites drawn as one run are split across atlases.");
+			}
+		}
+		return atlas;
+	};
+	uint8_t tile_atlas = shared_atlas({&floor, &wall, &wall_dark});
+	uint8_t wire_atlas = shared_atlas({&wire_vert, &wire_hori, &wire_up_right, &wire_up_left, &wire_down_right, &wire_down_left,
+		&wire_right_up, &wire_left_up, &wire_right_down, &wire_left_down});
+
+	//Instanced draws are sorted into two passes: opaque sprites front-to-back (so the depth
+	// test rejects what they cover), then translucent ones back-to-front (so they blend in
+	// painter's order); within a pass, by draw order, then atlas:
+	enum Pass : uint8_t { PassOpaque = 0, PassTranslucent = 1 };
+	auto pass_order = [](Pass pass, uint16_t layer) {
+		return uint8_t(pass == PassOpaque ? LayerCount - 1 - layer : layer);
+	};
+
+	//------------ sprite drawing ------------
+	//appends the four quad corners for 'quad' placed at 'at' to 'verts':
+	auto draw_sprite = [](std::vector< Vertex > &verts, SpriteQuad const &quad, glm::vec2 const &at) {
+		glm::vec2 min = at + quad.min_at;
+		glm::vec2 max = at + quad.max_at;
+		verts.emplace_back(min, quad.min_uv);
+		verts.emplace_back(glm::vec2(min.x, max.y), glm::vec2(quad.min_uv.x, quad.max_uv.y));
+		verts.emplace_back(glm::vec2(max.x, min.y), glm::vec2(quad.max_uv.x, quad.min_uv.y));
+		verts.emplace_back(max, quad.max_uv);
+	};
+
+	//Runs of quads (the text) go through the batch kernels in QuadBatch.hpp instead,
+	// which place copies of each quad's corners as baked at the origin:
+	auto bake_template = [&draw_sprite](SpriteQuad const &quad) {
+		std::vector< Vertex > corners;
+		draw_sprite(corners, quad, glm::vec2(0.0f));
+		QuadTemplate ret;
+		std::copy(corners.begin(), corners.end(), ret.corners);
+		return ret;
+	};
+
+	//the strips only have digits and one case of letters; other characters (' ', punctuation) just advance:
+	GlyphTable glyphs;
+	for (int d = 0; d < 10; ++d) {
+		glyphs.set(char('0' + d), bake_template(digit_quads[d]));
+	}
+	for (int l = 0; l < 26; ++l) {
+		glyphs.set(char('a' + l), bake_template(letter_quads[l]));
+		glyphs.set(char('A' + l), bake_template(letter_quads[l]));
+	}
+	TextCache text_cache; //static strings, laid out once
+	TextMesh step_text; //the step counter, re-laid out in place when it changes
+	std::vector< Vertex > text_verts; //this frame's text quads (kept, so its storage is reused)
+	std::vector< Vertex > text_uploaded; //what 'text_buffer' holds
+	GLuint text_buffer = 0; //the text quads, re-sent only when they change
+	glGenBuffers(1, &text_buffer);
+
+	for (int i = 0; i < MAP_SIZE; i++) {
+		for (int j = 0; j < MAP_SIZE; j++) {
 			tiles[i][j].pos = glm::vec2(i,j);
 			if (i > 24 && i < 77 && j > 24 && j < 75) {
 				tiles[i][j].occupied = true;
@@ -354,11 +1127,115 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	poll_texture_load();
+
+	//------------ static tile layer ------------
+	//The background tiles rarely change, so their instances live in a chunked buffer
+	// (see TileChunks.hpp); set_tile_sprite() marks the tile's chunk for rebuilding
+	// right before the next draw.
+	auto sprite_index = [&sprites](std::vector< SpriteInfo >::iterator sprite) {
+		return uint16_t(sprite - sprites.begin());
+	};
+
+	std::unique_ptr< TileChunks > tile_chunks(new TileChunks(glm::ivec2(MAP_SIZE), sprite_index(floor.sprite)));
+	for (int i = 0; i < MAP_SIZE; i++) {
+		for (int j = 0; j < MAP_SIZE; j++) {
+			tile_chunks->set_sprite(glm::ivec2(i, j), sprite_index(tiles[i][j].sprite->sprite));
+		}
+	}
+
+	if (tex_load) { //the atlas should be decoded by now; finish its upload:
+		tex_load->finish();
+		if (tex_load->failed) {
+			std::cerr << "Failed to load texture." << std::endl;
+			exit(1);
+		}
+		tex_size = tex_load->size;
+		tex_load.reset();
+	}
+
+	//------------ tilemap textures ------------
+	//(for --background tilemap) one R16UI texel per tile holding its sprite index, plus
+	// a one-row table of each sprite's atlas rectangle; a tile edit is a 1-texel upload.
+	GLuint tile_map_tex = 0;
+	GLuint sprite_rects_tex = 0;
+	GLuint empty_vao = 0; //(the screen quad has no attributes, but core profile still wants a vao)
+	glm::vec2 tile_offset = sprite_quads[sprite_index(floor.sprite)].min_at;
+	std::vector< glm::u8vec2 > tile_map_dirty;
+	if (config.background == config.BackgroundTilemap) { //create tilemap textures:
+		//every background sprite must be a 1x1 tile sitting at the same offset:
+		for (Object const *object : {&floor, &wall, &wall_dark}) {
+			SpriteQuad const &quad = sprite_quads[sprite_index(object->sprite)];
+			if (quad.min_at != tile_offset || quad.max_at != tile_offset + glm::vec2(1.0f)) {
+				throw std::runtime_error("The tilemap background needs every tile sprite to be 1x1 with the same origin.");
+			}
+		}
+
+		std::vector< uint16_t > indices(MAP_SIZE * MAP_SIZE);
+		for (int i = 0; i < MAP_SIZE; i++) {
+			for (int j = 0; j < MAP_SIZE; j++) {
+				indices[j * MAP_SIZE + i] = sprite_index(tiles[i][j].sprite->sprite);
+			}
+		}
+		glGenTextures(1, &tile_map_tex);
+		glBindTexture(GL_TEXTURE_2D, tile_map_tex);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, MAP_SIZE, MAP_SIZE, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &indices[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		std::vector< glm::vec4 > rects; //(row 0: rectangles, row 1: animations)
+		for (auto const &quad : sprite_quads) {
+			rects.emplace_back(quad.min_uv * glm::vec2(tex_size), quad.max_uv * glm::vec2(tex_size));
+		}
+		for (auto const &animation : sprite_animations) {
+			rects.emplace_back(glm::vec2(animation.frames, animation.frames_per_second), stride_uv(animation) * glm::vec2(tex_size));
+		}
+		glGenTextures(1, &sprite_rects_tex);
+		glBindTexture(GL_TEXTURE_2D, sprite_rects_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, sprite_quads.size(), 2, 0, GL_RGBA, GL_FLOAT, &rects[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glGenVertexArrays(1, &empty_vao);
+	}
+
+	//changes a tile; the edit reaches the GPU at the next apply_tile_edits():
+	auto set_tile_sprite = [&tiles, &tile_chunks, &sprite_index, &tile_map_tex, &tile_map_dirty](glm::u8vec2 const &pos, Object *sprite) {
+		tiles[pos.x][pos.y].sprite = sprite;
+		tile_chunks->set_sprite(glm::ivec2(pos), sprite_index(sprite->sprite));
+		if (tile_map_tex) tile_map_dirty.emplace_back(pos);
+	};
+
+	//------------ retained sprite layer ------------
+	//Everything drawn from the sprite table apart from the tiles and the wire lives in a SpriteLayer,
+	// changed through handles as the game changes (see SpriteLayer.hpp).
+	//It is bucketed by (pass, order, atlas), so each bucket is one DrawQueue item.
+	auto sprite_bucket = [&atlases](Pass pass, uint8_t order, uint8_t atlas) {
+		return (uint32_t(pass) * LayerCount + order) * uint32_t(atlases.size()) + atlas;
+	};
+	std::unique_ptr< SpriteLayer > sprite_layer(new SpriteLayer(sprite_bucket(PassTranslucent, LayerCount, 0),
+		[&](SpriteInstance const &instance) {
+			Pass pass = (sprite_opaque[instance.sprite] ? PassOpaque : PassTranslucent);
+			return sprite_bucket(pass, pass_order(pass, instance.layer), sprite_atlas[instance.sprite]);
+		}
+	));
+
+	//The wire only ever grows or shrinks at the player's end, so it is a stack on the GPU
+	// (see SpriteStack.hpp) drawn in one go:
+	std::unique_ptr< SpriteStack > wire_stack(new SpriteStack(2 * MAX_STEPS));
+	auto wire_instance = [&sprite_index](std::vector< SpriteInfo >::iterator sprite, glm::u8vec2 const &pos) {
+		return SpriteInstance(pos, sprite_index(sprite), glm::u8vec4(0xff), LayerWires);
+	};
+
 	enum Dir { UP = 1, DOWN = -1, RIGHT = 2, LEFT = -2 };
 
 	struct Wire : public Object{
 		Wire* prev_wire;
 		Dir dir;
+		GLsizei index; //its instance in wire_stack
 	};
 
 	Tile player;
@@ -382,7 +1259,8 @@ int main(int argc, char **argv) {
 	//initial wire layer
 	auto add_wire = [&wires, &tiles, &wire_vert,
 			 &wire_hori, &wire_up_right, &wire_up_left,
-			 &wire_down_right, &wire_down_left
+			 &wire_down_right, &wire_down_left,
+			 &wire_stack, &wire_instance, &gl_state
 			] (const glm::u8vec2 &pos, Dir type) {
 		Wire* wire = new Wire();
 		wire->pos = pos;
@@ -398,14 +1276,21 @@ int main(int argc, char **argv) {
 			break;
 		}
 		wire->dir = type;
+		wire->index = wire_stack->size();
+		uint64_t reallocations = wire_stack->reallocations;
+		wire_stack->push(wire_instance(wire->sprite, wire->pos));
+		if (wire_stack->reallocations != reallocations) {
+			gl_state.forget_array_buffer(); //(growing deleted the old buffer, which may have been bound)
+		}
 		wires = wire;
 		tiles[pos.x][pos.y].occupied = true;
 		tiles[pos.x][pos.y].object = wire;
 		//std::cerr << "a" << wires << std::endl;
 	};
 
-	auto delete_wire = [&wires, &tiles](){
+	auto delete_wire = [&wires, &tiles, &wire_stack](){
 		Wire* wire = wires;
+		wire_stack->pop();
 		tiles[wires->pos.x][wires->pos.y].occupied = false;
 		tiles[wires->pos.x][wires->pos.y].object = nullptr;
 		wires = wires->prev_wire;
@@ -414,6 +1299,13 @@ int main(int argc, char **argv) {
 		//std::cerr << "t" << wires << std::endl;
 	};
 
+	auto set_wire_sprite = [&wire_stack, &wire_instance](Wire *wire, Object const &object) {
+		if (wire->index == 0) return; //(the plugged-in end keeps its blinking wire_socket sprite)
+		if (wire->sprite == object.sprite) return;
+		wire->sprite = object.sprite;
+		wire_stack->set(wire->index, wire_instance(wire->sprite, wire->pos));
+	};
+
 	bool chat = false;
 
 	add_wire(glm::u8vec2(5, 0), Dir::UP);
@@ -422,8 +1314,16 @@ int main(int argc, char **argv) {
 	add_wire(glm::u8vec2(5, 3), Dir::UP);
 	add_wire(glm::u8vec2(5, 4), Dir::UP);
 	add_wire(glm::u8vec2(5, 5), Dir::UP);
+	//the first piece is where the wire is plugged in (it is never removed), so it blinks:
+	wire_stack->set(0, SpriteInstance(glm::u8vec2(5, 0), wire_socket, glm::u8vec4(0xff), LayerWires));
 	int step_count = 5;
 
+	SpriteLayer::Handle sweeper_handle = sprite_layer->create_sprite(sprite_index(sweeper.sprite), sweeper.pos, LayerSweeper);
+	SpriteLayer::Handle player_handle = sprite_layer->create_sprite(sprite_index(player.sprite->sprite), player.pos, LayerPlayer);
+	SpriteLayer::Handle step_display_handle = sprite_layer->create_sprite(sprite_index(step_cnt_display.sprite->sprite), player.pos + glm::u8vec2(10, 10), LayerHud);
+	SpriteLayer::Handle dialog_handle = SpriteLayer::InvalidHandle; //(only while chatting)
+	(void)sweeper_handle; //the sweeper never moves
+
 	//------------ game state ------------
 
 	struct {
@@ -433,10 +1333,538 @@ int main(int argc, char **argv) {
 	//correct radius for aspect ratio:
 	camera.radius.x = camera.radius.y * (float(config.size.x) / float(config.size.y));
 
-	//------------ game loop ------------
+	//range of tiles [min, max) that can show up on screen, with a one-tile margin
+	// (tile (i,j) covers [i,i+1]x[j-1,j], plus taller sprites may poke in):
+	struct TileRect {
+		glm::ivec2 min;
+		glm::ivec2 max;
+	};
+	auto visible_tiles = [](glm::vec2 const &at, glm::vec2 const &radius) {
+		TileRect rect;
+		rect.min.x = std::max(0, int(std::floor(at.x - radius.x)) - 1);
+		rect.min.y = std::max(0, int(std::floor(at.y - radius.y)) - 1);
+		rect.max.x = std::min(MAP_SIZE, int(std::ceil(at.x + radius.x)) + 1);
+		rect.max.y = std::min(MAP_SIZE, int(std::ceil(at.y + radius.y)) + 1);
+		rect.max = glm::max(rect.min, rect.max);
+		return rect;
+	};
+
+	//projection showing the world rectangle at +/- radius:
+	auto make_mvp = [](glm::vec2 const &at, glm::vec2 const &radius) {
+		glm::vec2 scale = 1.0f / radius;
+		glm::vec2 offset = scale * -at;
+		return glm::mat4(
+			glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
+			glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
+			glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+			glm::vec4(offset.x, offset.y, 0.0f, 1.0f)
+		);
+	};
+
+	//draws the chunks of 'chunks' overlapping 'rect' (after use_sprite_program(path, ...)); returns the draw count:
+	std::vector< TileChunks::Range > tile_ranges; //(reused every call)
+	auto draw_tiles = [&tile_ranges, &draw_sprite_instances](SpritePath path, TileChunks const &chunks, TileRect const &rect) {
+		tile_ranges.clear();
+		chunks.visible(rect.min, rect.max, &tile_ranges);
+		for (auto const &range : tile_ranges) {
+			draw_sprite_instances(path, chunks.buffer, range.offset, range.count);
+		}
+		return tile_ranges.size();
+	};
+
+	//a frame's instanced draws, sorted into batches (see DrawQueue.hpp):
+	DrawQueue draw_queue(sizeof(SpriteInstance));
+
+	//------------ pixel-art framebuffer ------------
+	//The scene is drawn at 8 pixels per tile into an offscreen framebuffer, which is then
+	// blitted to the window scaled up by a whole number with nearest filtering; so the
+	// number of fragments shaded depends on the view, not on the window size.
+	//The view is trimmed so it covers a whole number of native pixels.
+	GLuint scene_fb = 0; //(0 == draw straight to the window)
+	glm::ivec2 scene_size = glm::ivec2(config.size);
+	int scene_scale = 1;
+	GLuint scene_color = 0;
+	GLuint scene_depth = 0;
+	if (config.pixel_framebuffer) { //create pixel-art framebuffer:
+		scene_scale = std::max(1, int(config.size.y) / int(std::round(2.0f * camera.radius.y * 8.0f)));
+		scene_size = glm::ivec2(config.size) / scene_scale;
+		camera.radius = glm::vec2(scene_size) / (2.0f * 8.0f);
+
+		glGenRenderbuffers(1, &scene_color);
+		glBindRenderbuffer(GL_RENDERBUFFER, scene_color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, scene_size.x, scene_size.y);
+		glGenRenderbuffers(1, &scene_depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, scene_depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, scene_size.x, scene_size.y);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &scene_fb);
+		glBindFramebuffer(GL_FRAMEBUFFER, scene_fb);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, scene_color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, scene_depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Pixel-art framebuffer is incomplete.");
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	//------------ background cache ------------
+	//The floor/wall layer around the camera is rendered once into an offscreen texture at the
+	// art's native 8 texels per tile, then drawn each frame as a single textured quad.
+	//It is re-rendered only when the view leaves the padded region it covers or a tile changes.
+	static const int BackgroundPadding = 8; //tiles of slack on each side of the view
+	glm::ivec2 background_size = glm::ivec2(glm::ceil(2.0f * camera.radius)) + glm::ivec2(2 + 2 + 2 * BackgroundPadding);
+	TileRect background_rect; //tiles held by the cache
+	bool background_valid = false;
+	GLuint background_tex = 0;
+	GLuint background_fb = 0;
+	GLuint background_buffer = 0; //the four corners of the cached region
+	GLuint background_vao = 0;
+	if (config.background == config.BackgroundCached) { //create background cache:
+		glGenTextures(1, &background_tex);
+		glBindTexture(GL_TEXTURE_2D, background_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, background_size.x * 8, background_size.y * 8, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glGenFramebuffers(1, &background_fb);
+		glBindFramebuffer(GL_FRAMEBUFFER, background_fb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, background_tex, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Background cache framebuffer is incomplete.");
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenBuffers(1, &background_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, background_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * VertsPerSprite, NULL, GL_DYNAMIC_DRAW);
+		glGenVertexArrays(1, &background_vao);
+		glBindVertexArray(background_vao);
+		bind_vertex_attributes(0);
+	}
+
+	//re-centers the cache on the camera and renders the tiles into it:
+	auto render_background = [&]() {
+		glm::ivec2 at = glm::ivec2(glm::floor(camera.at));
+		background_rect.min = at - background_size / 2;
+		background_rect.max = background_rect.min + background_size;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, background_fb);
+		glViewport(0, 0, background_size.x * 8, background_size.y * 8);
+		glClearColor(0.0, 0.0, 0.0, 0.0);
+		glClear(GL_COLOR_BUFFER_BIT);
+		//(keep the alpha channel a coverage value, so compositing the cache blends like the tiles did)
+		gl_state.set_blend(true);
+		gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		glm::vec2 min = glm::vec2(background_rect.min);
+		glm::vec2 max = glm::vec2(background_rect.max);
+		use_sprite_program(config.sprites, make_mvp(0.5f * (min + max), 0.5f * (max - min)));
+		//(the cache is a still picture, so tiles are not animated in it: each shows its first frame)
+		glUniform1f(config.sprites == SpritesPoints ? point_program_time : sprite_program_time, 0.0f);
+		gl_state.bind_texture(0, atlases[tile_atlas]);
+		size_t draws = draw_tiles(config.sprites, *tile_chunks, background_rect);
+
+		//(back to the opaque pass's state, where this gets called)
+		gl_state.set_blend(false);
+		gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glBindFramebuffer(GL_FRAMEBUFFER, scene_fb);
+		glViewport(0, 0, scene_size.x, scene_size.y);
+
+		//the cache is only drawn where there are tiles, so every texel it shows is opaque:
+		glm::vec2 clip_min = glm::max(min, tile_offset);
+		glm::vec2 clip_max = glm::min(max, tile_offset + glm::vec2(float(MAP_SIZE)));
+		std::vector< Vertex > corners;
+		draw_sprite(corners, SpriteQuad{ glm::vec2(0.0f), clip_max - clip_min, (clip_min - min) / (max - min), (clip_max - min) / (max - min) }, clip_min);
+		gl_state.bind_array_buffer(background_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * corners.size(), &corners[0]);
+
+		background_valid = true;
+		return draws;
+	};
+
+
+	//------------ frame stats ------------
+	const uint64_t StripVertexBytes = 20; //the old float position + uv + byte color vertex
+	//counters accumulated while drawing, reported as per-frame averages by --stats:
+	struct {
+		uint64_t frames = 0;
+		uint64_t upload_bytes = 0; //bytes sent with glBufferData / glBufferSubData
+		uint64_t strip_bytes = 0; //what the same sprites cost as six-vertex triangle strips (of StripVertexBytes vertices)
+		uint64_t draw_calls = 0;
+		uint64_t background_renders = 0; //times the background cache was redrawn
+		float elapsed = 0.0f;
+	} stats;
+
+	//sends the tile edits made with set_tile_sprite since the last call to whichever background is in use:
+	auto apply_tile_edits = [&]() {
+		//rebuild any tile chunks that changed:
+		size_t bytes = tile_chunks->update();
+		stats.upload_bytes += bytes;
+		stats.strip_bytes += bytes / sizeof(SpriteInstance) * StripVertexBytes * 6;
+		if (bytes != 0) background_valid = false;
+
+		if (!tile_map_dirty.empty()) {
+			//patch edited tiles in the tile map, one texel each:
+			gl_state.bind_texture(1, tile_map_tex);
+			for (auto const &pos : tile_map_dirty) {
+				uint16_t index = sprite_index(tiles[pos.x][pos.y].sprite->sprite);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &index);
+				stats.upload_bytes += sizeof(index);
+			}
+			tile_map_dirty.clear();
+		}
+	};
+
+	//------------ views ------------
+	//Each frame's sprite and text data is uploaded once and then drawn into every view with
+	// that view's mvp and viewport; so N views cost N sets of draw calls, not N rebuilds.
+	struct View {
+		glm::vec2 at; //world position shown at the middle (like 'camera')
+		glm::vec2 radius;
+		glm::ivec2 min; //viewport in the scene framebuffer, in pixels
+		glm::ivec2 size;
+	};
+	std::vector< View > views; //views[0] is the main view (the one the background cache follows)
+
+	//places this frame's views around 'camera':
+	auto layout_views = [&]() {
+		float pixels_per_tile = float(scene_size.y) / (2.0f * camera.radius.y);
+		auto make_view = [&pixels_per_tile](glm::vec2 const &at, float zoom, glm::ivec2 const &min, glm::ivec2 const &size) {
+			return View{ at, glm::vec2(size) / (2.0f * pixels_per_tile) * zoom, min, size };
+		};
+		views.clear();
+		if (config.views == config.ViewsSplit) {
+			//left half follows the player, right half watches the sweeper:
+			glm::ivec2 left = glm::ivec2(scene_size.x / 2, scene_size.y);
+			views.emplace_back(make_view(camera.at, 1.0f, glm::ivec2(0), left));
+			views.emplace_back(make_view(glm::vec2(sweeper.pos), 1.0f, glm::ivec2(left.x, 0), scene_size - glm::ivec2(left.x, 0)));
+		} else {
+			views.emplace_back(make_view(camera.at, 1.0f, glm::ivec2(0), scene_size));
+			if (config.views == config.ViewsInset) {
+				//zoomed-out overview in the top right corner:
+				glm::ivec2 size = scene_size / 3;
+				views.emplace_back(make_view(camera.at, 4.0f, scene_size - size - glm::ivec2(4), size));
+			}
+		}
+	};
+
+	//draws the frame's queued batches, background, and text (the first 'text_quads' in text_buffer) into 'view':
+	auto draw_view = [&](View const &view, GLuint text_quads) {
+		glm::mat4 mvp = make_mvp(view.at, view.radius);
+
+		//draws the queued batches of 'pass' (gl_state drops the atlas binds that don't change):
+		auto draw_batches = [&](Pass pass) {
+			DrawQueue::Item const *previous = nullptr;
+			for (auto const &batch : draw_queue.batches) {
+				if (batch.pass != pass) continue;
+				if (!previous || previous->program != batch.program) {
+					use_sprite_program(SpritePath(batch.program), mvp);
+				}
+				gl_state.bind_texture(0, atlases[batch.texture]);
+				draw_sprite_instances(SpritePath(batch.program), batch.buffer, batch.offset, batch.count);
+				stats.draw_calls += 1;
+				previous = &batch;
+			}
+		};
+
+		//---- opaque pass: depth test and write, no blending ----
+		gl_state.set_blend(false);
+		gl_state.depth_mask(true);
+
+		draw_batches(PassOpaque);
+
+		//the tile layer is the farthest opaque layer, so it goes last:
+		if (config.background == config.BackgroundTilemap) {
+			gl_state.use_program(tilemap_program);
+			glUniform2fv(tilemap_program_view_min, 1, glm::value_ptr(view.at - view.radius));
+			glUniform2fv(tilemap_program_view_max, 1, glm::value_ptr(view.at + view.radius));
+			glUniform2fv(tilemap_program_tile_offset, 1, glm::value_ptr(tile_offset));
+			glUniform1f(tilemap_program_time, animation_time);
+			gl_state.bind_texture(1, tile_map_tex);
+			gl_state.bind_texture(2, sprite_rects_tex);
+			gl_state.bind_texture(0, tex);
+			gl_state.bind_vertex_array(empty_vao);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			stats.draw_calls += 1;
+		} else if (config.background == config.BackgroundCached && &view == &views[0]) {
+			//background comes from the cache (kept up to date before the views are drawn):
+			gl_state.use_program(program);
+			glUniform1ui(program_layer, LayerTiles);
+			glUniform1i(program_paletted, GL_FALSE);
+			glUniformMatrix4fv(program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+			gl_state.bind_texture(0, background_tex);
+			gl_state.bind_vertex_array(background_vao);
+			glDrawElements(GL_TRIANGLES, IndicesPerSprite, GL_UNSIGNED_INT, (GLbyte *)0);
+			glUniform1i(program_paletted, GL_TRUE);
+			stats.draw_calls += 1;
+		} else {
+			//the chunks this view overlaps, one contiguous run of instances (one instanced draw) per chunk row:
+			//(with --background cached, for views other than the main one, which the cache doesn't cover)
+			use_sprite_program(config.sprites, mvp);
+			gl_state.bind_texture(0, atlases[tile_atlas]);
+			stats.draw_calls += draw_tiles(config.sprites, *tile_chunks, visible_tiles(view.at, view.radius));
+		}
+
+		//---- translucent pass: depth test (against the opaque layers) and blending, no depth write ----
+		gl_state.set_blend(true);
+		gl_state.depth_mask(false);
+
+		draw_batches(PassTranslucent);
+
+		//followed by the text quads:
+		gl_state.bind_texture(0, tex);
+		gl_state.use_program(program);
+		glUniform1ui(program_layer, LayerText);
+		glUniformMatrix4fv(program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+		gl_state.bind_vertex_array(vao);
+		gl_state.bind_array_buffer(text_buffer);
+		bind_vertex_attributes(0);
+		glDrawElements(GL_TRIANGLES, text_quads * IndicesPerSprite, GL_UNSIGNED_INT, (GLbyte *)0);
+		stats.draw_calls += 1;
+	};
 
 	bool should_quit = false;
-	while (true) {
+
+	//(the setup above binds things directly)
+	gl_state.invalidate();
+
+	if (config.stats) { //report startup time (run once with --no-program-cache to compare):
+		double startup_seconds = std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - startup_begin).count();
+		std::cout << "startup: " << 1000.0 * startup_seconds << " ms, "
+			<< 1000.0 * program_build_seconds << " ms of it building shader programs";
+		if (!program_cache) {
+			std::cout << " (program cache off)";
+		} else if (!program_cache->enabled) {
+			std::cout << " (program binaries not supported by this driver)";
+		} else {
+			std::cout << " (program cache: " << program_cache->hits << " hits, " << program_cache->misses << " misses, "
+				<< program_cache->rejected << " rejected)";
+		}
+		std::cout << std::endl;
+	}
+
+	//------------ benchmarks ------------
+	//(each one runs instead of the game)
+
+	if (config.bench_sprites) { //sprites/sec through each way of drawing sprites:
+		typedef std::chrono::high_resolution_clock Clock;
+		const int Count = 100000;
+		const int Frames = 30;
+
+		//sprites scattered over the view:
+		std::vector< glm::vec2 > positions;
+		std::vector< uint16_t > indices;
+		for (int k = 0; k < Count; ++k) {
+			positions.emplace_back(
+				camera.at.x - camera.radius.x + float((k * 7919) % int(20.0f * camera.radius.x)) / 10.0f,
+				camera.at.y - camera.radius.y + float((k * 104729) % int(20.0f * camera.radius.y)) / 10.0f
+			);
+			indices.emplace_back(k % sprites.size());
+		}
+
+		glm::mat4 mvp = make_mvp(camera.at, camera.radius);
+		gl_state.bind_texture(0, tex);
+
+		enum { Quads, Instanced, Points } const paths[] = { Quads, Instanced, Points };
+		char const *names[] = { "quads (CPU-built, indexed)", "instanced", "points (geometry shader)" };
+		std::vector< Vertex > verts;
+		std::vector< SpriteInstance > instances;
+		for (auto path : paths) {
+			glClear(GL_COLOR_BUFFER_BIT);
+			auto before = Clock::now();
+			for (int f = 0; f < Frames; ++f) {
+				if (path == Quads) {
+					verts.clear();
+					for (int k = 0; k < Count; ++k) {
+						draw_sprite(verts, sprite_quads[indices[k]], positions[k]);
+					}
+					GLintptr offset = vertex_stream->write(verts.data(), sizeof(Vertex) * verts.size());
+					reserve_quad_indices(Count);
+					gl_state.use_program(program);
+					glUniformMatrix4fv(program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+					gl_state.bind_vertex_array(vao);
+					gl_state.bind_array_buffer(vertex_stream->buffer);
+					bind_vertex_attributes(offset);
+					glDrawElements(GL_TRIANGLES, Count * IndicesPerSprite, GL_UNSIGNED_INT, (GLbyte *)0);
+					vertex_stream->next_frame();
+				} else {
+					SpritePath sprite_path = (path == Points ? SpritesPoints : SpritesInstanced);
+					instances.clear();
+					for (int k = 0; k < Count; ++k) {
+						instances.emplace_back(positions[k], indices[k], glm::u8vec4(0xff));
+					}
+					GLintptr offset = instance_stream->write(instances.data(), sizeof(SpriteInstance) * instances.size());
+					use_sprite_program(sprite_path, mvp);
+					draw_sprite_instances(sprite_path, instance_stream->buffer, offset, Count);
+					instance_stream->next_frame();
+				}
+			}
+			glFinish();
+			auto after = Clock::now();
+			double seconds = std::chrono::duration< double >(after - before).count();
+			std::cout << names[path] << ": " << (double(Count) * Frames / seconds) / 1.0e6 << " million sprites/sec" << std::endl;
+		}
+		should_quit = true;
+	}
+
+	if (config.bench_quads) { //CPU cost of building quads, per-sprite vs. batched:
+		typedef std::chrono::high_resolution_clock Clock;
+
+		std::vector< QuadTemplate > sprite_templates; //parallel to 'sprites'
+		for (auto const &quad : sprite_quads) {
+			sprite_templates.emplace_back(bake_template(quad));
+		}
+		std::vector< uint16_t > unit_tiles; //sprites that are plain 8x8 tiles
+		for (size_t s = 0; s < sprite_templates.size(); ++s) {
+			if (is_unit_tile(sprite_templates[s])) unit_tiles.emplace_back(uint16_t(s));
+		}
+		if (unit_tiles.empty()) unit_tiles.emplace_back(uint16_t(0)); //(can't happen with this atlas)
+
+		for (size_t count : {size_t(10000), size_t(100000), size_t(1000000)}) {
+			std::vector< glm::vec2 > positions;
+			std::vector< uint16_t > indices;
+			for (size_t k = 0; k < count; ++k) {
+				positions.emplace_back(float((k * 7919) % 4096) / 8.0f, float((k * 104729) % 4096) / 8.0f);
+				indices.emplace_back(uint16_t(k % sprites.size()));
+			}
+			//(about the same total work at every size)
+			size_t reps = std::max(size_t(1), size_t(10000000) / count);
+
+			std::vector< Vertex > verts;
+			verts.reserve(VertsPerSprite * count);
+			auto time = [&](std::function< void() > const &build) {
+				build(); //(warm up)
+				auto before = Clock::now();
+				for (size_t r = 0; r < reps; ++r) {
+					build();
+				}
+				auto after = Clock::now();
+				double seconds = std::chrono::duration< double >(after - before).count();
+				return (double(count) * reps / seconds) / 1.0e6;
+			};
+
+			std::cout << count << " sprites (million sprites/sec):" << std::endl;
+			std::cout << "  draw_sprite lambda: " << time([&]() {
+				verts.clear();
+				for (size_t k = 0; k < count; ++k) {
+					draw_sprite(verts, sprite_quads[indices[k]], positions[k]);
+				}
+			}) << std::endl;
+			verts.resize(VertsPerSprite * count);
+			for (auto const &kernel : quad_kernels()) {
+				std::cout << "  " << kernel.name << " batch: " << time([&]() {
+					kernel.emit(sprite_templates.data(), positions.data(), indices.data(), count, verts.data());
+				}) << std::endl;
+			}
+			//the same batch with every sprite swapped for a unit tile, through both shapes:
+			std::vector< uint16_t > tile_indices(count);
+			for (size_t k = 0; k < count; ++k) {
+				tile_indices[k] = unit_tiles[k % unit_tiles.size()];
+			}
+			for (auto const &kernel : quad_kernels()) {
+				for (QuadShape shape : {QuadGeneral, QuadUnitTile}) {
+					EmitQuads emit = kernel.emit_shape(shape);
+					std::cout << "  " << kernel.name << " unit tiles, " << (shape == QuadUnitTile ? "unit" : "general") << " shape: " << time([&]() {
+						emit(sprite_templates.data(), positions.data(), tile_indices.data(), count, verts.data());
+					}) << std::endl;
+				}
+			}
+		}
+		should_quit = true;
+	}
+
+	if (config.bench_chunks) { //time the chunked tile layer as the map grows:
+		typedef std::chrono::high_resolution_clock Clock;
+		auto ms = [](Clock::time_point a, Clock::time_point b) {
+			return std::chrono::duration< double, std::milli >(b - a).count();
+		};
+
+		gl_state.bind_texture(0, tex);
+
+		std::cout << "map size, build ms, frame ms (draws), edit ms (1 tile), re-emit all tiles ms" << std::endl;
+		for (int map_size : {100, 256, 512, 1024, 2048, 4096}) {
+			auto before_build = Clock::now();
+			TileChunks chunks(glm::ivec2(map_size), sprite_index(floor.sprite));
+			for (int x = 0; x < map_size; ++x) {
+				for (int y = 0; y < map_size; ++y) {
+					if ((x / 7 + y / 5) % 3 == 0) chunks.set_sprite(glm::ivec2(x, y), sprite_index(wall.sprite));
+				}
+			}
+			chunks.update();
+			glFinish();
+			auto after_build = Clock::now();
+
+			//draw the camera-sized view in the middle of the map:
+			glm::vec2 at = glm::vec2(0.5f * map_size);
+			use_sprite_program(config.sprites, make_mvp(at, camera.radius));
+			TileRect view;
+			view.min = glm::ivec2(glm::floor(at - camera.radius)) - glm::ivec2(1);
+			view.max = glm::ivec2(glm::ceil(at + camera.radius)) + glm::ivec2(1);
+			const int Frames = 100;
+			auto before_frames = Clock::now();
+			for (int f = 0; f < Frames; ++f) {
+				draw_tiles(config.sprites, chunks, view);
+			}
+			glFinish();
+			auto after_frames = Clock::now();
+
+			//change one tile per frame, as wires / objects would:
+			auto before_edits = Clock::now();
+			for (int f = 0; f < Frames; ++f) {
+				glm::ivec2 tile = glm::ivec2((f * 7919) % map_size, (f * 104729) % map_size);
+				uint16_t sprite = chunks.get_sprite(tile) == sprite_index(wall.sprite) ? sprite_index(floor.sprite) : sprite_index(wall.sprite);
+				chunks.set_sprite(tile, sprite);
+				chunks.update();
+			}
+			glFinish();
+			auto after_edits = Clock::now();
+
+			//what re-emitting every tile each frame (the old draw loop) costs on the CPU alone:
+			auto before_emit = Clock::now();
+			{
+				std::vector< SpriteInstance > all;
+				all.reserve(size_t(map_size) * map_size);
+				for (int x = 0; x < map_size; ++x) {
+					for (int y = 0; y < map_size; ++y) {
+						all.emplace_back(glm::vec2(x, y), chunks.get_sprite(glm::ivec2(x, y)), glm::u8vec4(0xff));
+					}
+				}
+			}
+			auto after_emit = Clock::now();
+
+			std::cout << map_size << "x" << map_size
+				<< ", " << ms(before_build, after_build)
+				<< ", " << ms(before_frames, after_frames) / Frames << " (" << tile_ranges.size() << ")"
+				<< ", " << ms(before_edits, after_edits) / Frames
+				<< ", " << ms(before_emit, after_emit)
+				<< std::endl;
+		}
+
+		{ //edits to the game's own map, through set_tile_sprite to the --background in use:
+			const int Edits = 100;
+			auto before_edits = Clock::now();
+			for (int e = 0; e < Edits; ++e) {
+				glm::u8vec2 pos = glm::u8vec2((e * 7919) % MAP_SIZE, (e * 104729) % MAP_SIZE);
+				Object *was = tiles[pos.x][pos.y].sprite;
+				set_tile_sprite(pos, was == &wall ? &floor : &wall);
+				apply_tile_edits();
+				set_tile_sprite(pos, was);
+				apply_tile_edits();
+			}
+			glFinish();
+			auto after_edits = Clock::now();
+			std::cout << "game map " << MAP_SIZE << "x" << MAP_SIZE << ", edit ms (1 tile changed and changed back): "
+				<< ms(before_edits, after_edits) / Edits << std::endl;
+		}
+		should_quit = true;
+	}
+
+	//------------ game loop ------------
+
+	while (!should_quit) {
 		static SDL_Event evt;
 		while (SDL_PollEvent(&evt) == 1) {
 			//handle input:
@@ -471,15 +1899,15 @@ int main(int argc, char **argv) {
 
 						if (player_dir == wires->dir) {
 							//No adjustments needed
-							wires->sprite = wire_vert.sprite;
+							set_wire_sprite(wires, wire_vert);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::LEFT) {
-							wires->sprite = wire_left_up.sprite;
+							set_wire_sprite(wires, wire_left_up);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::RIGHT) {
-							wires->sprite = wire_right_up.sprite;
+							set_wire_sprite(wires, wire_right_up);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						}
@@ -508,15 +1936,15 @@ int main(int argc, char **argv) {
 						}
 						if (player_dir == wires->dir) {
 							//No adjustments needed
-							wires->sprite = wire_hori.sprite;
+							set_wire_sprite(wires, wire_hori);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::UP) {
-							wires->sprite = wire_up_right.sprite;
+							set_wire_sprite(wires, wire_up_right);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::DOWN) {
-							wires->sprite = wire_down_right.sprite;
+							set_wire_sprite(wires, wire_down_right);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						}
@@ -545,15 +1973,15 @@ int main(int argc, char **argv) {
 						}
 						if (player_dir == wires->dir) {
 							//No adjustments needed
-							wires->sprite = wire_hori.sprite;
+							set_wire_sprite(wires, wire_hori);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::UP) {
-							wires->sprite = wire_up_left.sprite;
+							set_wire_sprite(wires, wire_up_left);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::DOWN) {
-							wires->sprite = wire_down_left.sprite;
+							set_wire_sprite(wires, wire_down_left);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						}
@@ -582,15 +2010,15 @@ int main(int argc, char **argv) {
 						}
 						if (player_dir == wires->dir) {
 							//No adjustments needed
-							wires->sprite = wire_vert.sprite;
+							set_wire_sprite(wires, wire_vert);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::LEFT) {
-							wires->sprite = wire_left_down.sprite;
+							set_wire_sprite(wires, wire_left_down);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						} else if (wires->dir == Dir::RIGHT) {
-							wires->sprite = wire_right_down.sprite;
+							set_wire_sprite(wires, wire_right_down);
 							add_wire(player.pos, player_dir);
 							step_count++;
 						}
@@ -624,129 +2052,185 @@ int main(int argc, char **argv) {
 		previous_time = current_time;
 
 		{ //update game state:
-			(void)elapsed;
+			animation_time += elapsed;
+
+			//(these only mark the sprite layer dirty when something actually changed)
+			sprite_layer->move(player_handle, player.pos);
+			sprite_layer->set_sprite(player_handle, sprite_index(player.sprite->sprite));
+			sprite_layer->move(step_display_handle, step_cnt_display.pos);
+			if (chat && dialog_handle == SpriteLayer::InvalidHandle) {
+				dialog_handle = sprite_layer->create_sprite(sprite_index(text_display.sprite), camera.at, LayerDialog);
+			} else if (!chat && dialog_handle != SpriteLayer::InvalidHandle) {
+				sprite_layer->destroy(dialog_handle);
+				dialog_handle = SpriteLayer::InvalidHandle;
+			}
+			if (dialog_handle != SpriteLayer::InvalidHandle) {
+				sprite_layer->move(dialog_handle, camera.at);
+			}
+		}
+
+		if (config.stats) { //report frame stats:
+			stats.elapsed += elapsed;
+			if (stats.elapsed > 1.0f && stats.frames > 0) {
+				std::cout << "per frame: "
+					<< stats.upload_bytes / stats.frames << " bytes uploaded"
+					<< " (" << stats.strip_bytes / stats.frames << " as triangle strips), "
+					<< float(stats.draw_calls) / stats.frames << " draws, "
+					<< float(gl_state.issued) / stats.frames << " GL state calls ("
+					<< float(gl_state.skipped) / stats.frames << " skipped as redundant)"
+					<< std::endl;
+				std::cout << "total over " << stats.frames << " frames: "
+					<< stats.background_renders << " background re-renders, "
+					<< (instance_stream->fence_waits + vertex_stream->fence_waits) << " fence waits ("
+					<< 1000.0 * (instance_stream->fence_wait_seconds + vertex_stream->fence_wait_seconds) << " ms waiting)"
+					<< std::endl;
+				gl_state.issued = 0;
+				gl_state.skipped = 0;
+				for (StreamBuffer *stream : {instance_stream.get(), vertex_stream.get()}) {
+					stream->fence_waits = 0;
+					stream->fence_wait_seconds = 0.0;
+				}
+				stats.frames = 0;
+				stats.upload_bytes = 0;
+				stats.strip_bytes = 0;
+				stats.draw_calls = 0;
+				stats.background_renders = 0;
+				stats.elapsed = 0.0f;
+			}
 		}
 
 		//draw output:
+		glBindFramebuffer(GL_FRAMEBUFFER, scene_fb);
+		glViewport(0, 0, scene_size.x, scene_size.y);
 		glClearColor(0.5, 0.5, 0.5, 0.0);
-		glClear(GL_COLOR_BUFFER_BIT);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		gl_state.depth_mask(true);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		gl_state.set_depth_test(true);
 
+		layout_views();
 
 		{ //draw game state:
-			std::vector< Vertex > verts;
-
-			auto draw_sprite = [&verts, &header](SpriteInfo const &sprite, glm::vec2 const &at) {
-				glm::vec2 min_uv;
-				min_uv.x = sprite.min_uv.x / header.text_size_x;
-				min_uv.y = 1.0f - sprite.min_uv.y / header.text_size_y;
-				//TODO: max_uv needs to be filled in
-				glm::vec2 max_uv;
-				max_uv.x = sprite.max_uv.x / header.text_size_x;
-				max_uv.y = 1.0f - sprite.max_uv.y / header.text_size_y;
-				//glm::vec2 max_uv = glm::vec2(1.0, 1.0);
-				//TODO: change how the rad is still 0, 0
-				//glm::vec2 rad = sprite.rad;
-				glm::vec2 top;
-				glm::vec2 bottom;
-				bottom.x = at.x - (sprite.origin.x - sprite.min_uv.x) / 8;
-				bottom.y = at.y - (sprite.max_uv.y - sprite.origin.y) / 8;
-				top.x = at.x + (sprite.max_uv.x - sprite.origin.x) / 8;
-				top.y = at.y + (sprite.origin.y - sprite.min_uv.y) / 8;
-				
-				//std::cerr << top.x << top.y << std::endl;
-				//std::cerr << bottom.x << bottom.y << std::endl;
-				glm::u8vec4 tint = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
-				verts.emplace_back(glm::vec2(bottom.x,bottom.y), glm::vec2(min_uv.x, max_uv.y), tint);
-				verts.emplace_back(verts.back());
-				verts.emplace_back(glm::vec2(bottom.x, top.y), glm::vec2(min_uv.x, min_uv.y), tint);
-				verts.emplace_back(glm::vec2(top.x,bottom.y), glm::vec2(max_uv.x, max_uv.y), tint);
-				verts.emplace_back(glm::vec2(top.x, top.y), glm::vec2(max_uv.x, min_uv.y), tint);
-				verts.emplace_back(verts.back());
-			};
-
-			std::string str;
-			str = std::to_string(step_count);
-
 			//Draw a sprite "player" at position (5.0, 2.0):
 			//stddatic SpriteInfo player; //TODO: hoist
 			//draw_sprite(player, glm::vec2(0.5, 0.5));
 			
-			for (int i = 0; i < 100; i++) {
-				for (int j = 0; j < 100; j++) {
-					draw_sprite(*tiles[i][j].sprite->sprite, glm::vec2(i, j));
-				}
+			apply_tile_edits();
+
+			{ //send whatever changed in the sprite layer:
+				size_t bytes = sprite_layer->update();
+				stats.upload_bytes += bytes;
+				stats.strip_bytes += StripVertexBytes * 6 * sprite_layer->size();
 			}
-			
-			Wire* wire = wires;
-			while (wire != nullptr) {
-				draw_sprite(*wire->sprite, wire->pos);
-				wire = wire->prev_wire;
-			}
-			//draw_sprite(*tiles[0][0].sprite->sprite, glm::vec2(0, 0));
-			draw_sprite(*sweeper.sprite, sweeper.pos);
-			draw_sprite(*player.sprite->sprite, player.pos);
-			draw_sprite(*step_cnt_display.sprite->sprite, step_cnt_display.pos);
-			
-			SpriteInfo num_sp;
-			int num_val;
-			int i = 0;
-			for (char& c : str) {
-				num_val = c - '0';
-				num_sp.max_uv = numbers.sprite->min_uv + glm::vec2(8 * num_val, 0);
-				num_sp.min_uv = numbers.sprite->min_uv + glm::vec2(8 * num_val + 8, 8);
-				num_sp.origin = numbers.sprite->origin + glm::vec2(8 * num_val, 0);
-				draw_sprite(num_sp, step_cnt_display.pos - glm::u8vec2(3 - i, 0));
-				i++;
+			{ //the wire stack uploaded as it changed:
+				stats.upload_bytes += wire_stack->uploaded_bytes;
+				stats.strip_bytes += StripVertexBytes * 6 * wire_stack->size();
+				wire_stack->uploaded_bytes = 0;
 			}
-
-			if (chat) {
-				draw_sprite(*text_display.sprite, camera.at);
-				int i = 0;
-				for (char& c : hi_message) {
-					num_val = c - 'a';
-					num_sp.max_uv = alphabets.sprite->min_uv + glm::vec2(8 * num_val, 0);
-					num_sp.min_uv = alphabets.sprite->min_uv + glm::vec2(8 * num_val + 8, 8);
-					num_sp.origin = alphabets.sprite->origin + glm::vec2(8 * num_val, 0);
-					draw_sprite(num_sp, camera.at - glm::vec2(13 - i, -1));
-					i++;
+			//queue up the instanced draws (the background is drawn separately, by each view):
+			draw_queue.clear();
+			for (Pass pass : {PassOpaque, PassTranslucent}) {
+				for (uint8_t order = 0; order < LayerCount; ++order) {
+					for (uint8_t atlas = 0; atlas < atlases.size(); ++atlas) {
+						uint32_t bucket = sprite_bucket(pass, order, atlas);
+						GLsizei begin = sprite_layer->bucket_begin(bucket);
+						draw_queue.submit(DrawQueue::Item{ pass, order, atlas, uint8_t(config.sprites),
+							sprite_layer->buffer, GLintptr(sizeof(SpriteInstance) * begin), sprite_layer->bucket_begin(bucket + 1) - begin });
+					}
 				}
-					
+			}
+			draw_queue.submit(DrawQueue::Item{ PassTranslucent, pass_order(PassTranslucent, LayerWires), wire_atlas, uint8_t(config.sprites),
+				wire_stack->buffer, 0, wire_stack->size() });
+			//(the tile chunks are not queued: the queue is shared by every view, but each view
+			// draws only the chunks it overlaps -- see draw_view)
+			draw_queue.sort();
+
+			//text glyphs are cut out of the alphabet / number strips, so they stay CPU-built quads
+			// (laid out only when the text changes, then just placed):
+			text_verts.clear();
+			step_text.set_number(glyphs, step_count);
+			step_text.append(glm::vec2(step_cnt_display.pos) - glm::vec2(3.0f, 0.0f), text_verts);
+			if (chat) {
+				text_cache.get(glyphs, hi_message).append(camera.at + glm::vec2(-13.0f, 1.0f), text_verts);
 			}
 
 			//rect(glm::vec2(0.0f, 0.0f), glm::vec2(1.0f), glm::u8vec4(0xff, 0x00, 0x00, 0xff));
 			//rect(mouse * camera.radius + camera.at, glm::vec2(1.0f, 1.0f), glm::u8vec4(0xff, 0xff, 0xff, 0x88));
 
 
-			glBindBuffer(GL_ARRAY_BUFFER, buffer);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * verts.size(), &verts[0], GL_STREAM_DRAW);
-
-			glUseProgram(program);
-			glUniform1i(program_tex, 0);
-			glm::vec2 scale = 1.0f / camera.radius;
-			glm::vec2 offset = scale * -camera.at;
-			glm::mat4 mvp = glm::mat4(
-				glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
-				glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
-				glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
-				glm::vec4(offset.x, offset.y, 0.0f, 1.0f)
-			);
-			glUniformMatrix4fv(program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+			//(a frame where no text changed or moved sends nothing)
+			if (text_verts.size() != text_uploaded.size()
+			 || (!text_verts.empty() && std::memcmp(text_verts.data(), text_uploaded.data(), sizeof(Vertex) * text_verts.size()) != 0)) {
+				glBindBuffer(GL_COPY_WRITE_BUFFER, text_buffer);
+				//(new storage, so a draw still reading the old text doesn't hold this up)
+				glBufferData(GL_COPY_WRITE_BUFFER, sizeof(Vertex) * text_verts.size(), text_verts.data(), GL_DYNAMIC_DRAW);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+				text_uploaded.swap(text_verts);
+				stats.upload_bytes += sizeof(Vertex) * text_uploaded.size();
+			}
+			GLuint sprite_count = text_uploaded.size() / VertsPerSprite;
+			reserve_quad_indices(sprite_count);
+			stats.strip_bytes += StripVertexBytes * 6 * sprite_count;
+
+			if (config.background == config.BackgroundCached) {
+				//the cache follows the main view, re-rendered if that view left it:
+				TileRect vis = visible_tiles(views[0].at, views[0].radius);
+				bool inside = background_rect.min.x <= vis.min.x && background_rect.min.y <= vis.min.y
+				           && vis.max.x <= background_rect.max.x && vis.max.y <= background_rect.max.y;
+				if (!background_valid || !inside) {
+					stats.draw_calls += render_background();
+					stats.background_renders += 1;
+					stats.upload_bytes += sizeof(Vertex) * VertsPerSprite;
+				}
+			}
 
-			glBindTexture(GL_TEXTURE_2D, tex);
-			glBindVertexArray(vao);
+			//Everything above is uploaded once; each view just draws it again with its own mvp:
+			if (views.size() > 1) glEnable(GL_SCISSOR_TEST);
+			for (auto const &view : views) {
+				glViewport(view.min.x, view.min.y, view.size.x, view.size.y);
+				if (views.size() > 1) {
+					glScissor(view.min.x, view.min.y, view.size.x, view.size.y);
+					if (&view != &views[0]) {
+						gl_state.depth_mask(true);
+						glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					}
+				}
+				draw_view(view, sprite_count);
+			}
+			if (views.size() > 1) glDisable(GL_SCISSOR_TEST);
+		}
 
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, verts.size());
+		if (scene_fb) { //upscale the native-resolution scene into the middle of the window:
+			glm::ivec2 scaled = scene_size * scene_scale;
+			glm::ivec2 origin = (glm::ivec2(config.size) - scaled) / 2;
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_fb);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glViewport(0, 0, config.size.x, config.size.y);
+			glClear(GL_COLOR_BUFFER_BIT); //(the border left over when the window isn't a whole multiple)
+			glBlitFramebuffer(0, 0, scene_size.x, scene_size.y,
+				origin.x, origin.y, origin.x + scaled.x, origin.y + scaled.y,
+				GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
 
 
+		stats.frames += 1;
+
 		SDL_GL_SwapWindow(window);
 	}
 
 
 	//------------  teardown ------------
 
+	while (wires != nullptr) {
+		delete_wire();
+	}
+	wire_stack.reset();
+	sprite_layer.reset();
+	tile_chunks.reset();
+	instance_stream.reset();
+	vertex_stream.reset();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -780,9 +2264,10 @@ static GLuint compile_shader(GLenum type, std::string const &source) {
 	return shader;
 }
 
-static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader) {
-	GLuint program = glCreateProgram();
+static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader, GLuint geometry_shader, GLuint program) {
+	if (!program) program = glCreateProgram();
 	glAttachShader(program, vertex_shader);
+	if (geometry_shader) glAttachShader(program, geometry_shader);
 	glAttachShader(program, fragment_shader);
 	glLinkProgram(program);
 	GLint link_status = GL_FALSE;